@@ -0,0 +1,100 @@
+#include "bench.hpp"
+#include "manto/network_address.hpp"
+#include <arpa/inet.h>
+
+namespace {
+
+void parse(bench_output& out, const char* name, std::string_view text) {
+  for (bench_run r(out, name); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      network_address addr;
+      auto rv = network_address::from_chars(text.data(), text.data() + text.size(), addr);
+      bench_keep(rv);
+      bench_keep(addr);
+    }
+  }
+}
+
+void format(bench_output& out, const char* name, std::string_view text) {
+  network_address addr(text);
+  char buffer[network_address::max_chars];
+  for (bench_run r(out, name); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      auto rv = addr.to_chars(buffer, buffer + sizeof(buffer));
+      bench_keep(rv);
+      bench_keep(buffer);
+    }
+  }
+}
+
+// inet_pton/inet_ntop take the bare address, so the baselines skip the port.
+void pton(bench_output& out, const char* name, int family, const char* text) {
+  uint8_t addr[16];
+  for (bench_run r(out, name); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      int rv = inet_pton(family, text, addr);
+      bench_keep(rv);
+      bench_keep(addr);
+    }
+  }
+}
+
+void ntop(bench_output& out, const char* name, int family, const char* text) {
+  uint8_t addr[16];
+  inet_pton(family, text, addr);
+  char buffer[INET6_ADDRSTRLEN];
+  for (bench_run r(out, name); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      const char* rv = inet_ntop(family, addr, buffer, sizeof(buffer));
+      bench_keep(rv);
+      bench_keep(buffer);
+    }
+  }
+}
+
+// The SSE2 and scalar IPv4 parsers have to agree on where an address ends,
+// and on what is not one.
+void check_dotted_quad() {
+#if defined(__SSE2__)
+  for (std::string_view text : { "1.2.3.4", "1.2.3.4.5", "1.2.3.4:80", "1.2.3.4.", "1.2.3.4a", "255.255.255.255",
+                                 "256.1.1.1", "1.2.3", "01.2.3.4", "1.2.3.45678", "1.1.1.1111111111", "" }) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    uint32_t scalarAddr = 0, sseAddr = 0;
+    const char* scalar = network_address_detail::parse_dotted_quad_scalar(first, last, scalarAddr);
+    const char* sse = network_address_detail::parse_dotted_quad_sse2(first, last, sseAddr);
+    if (scalar != sse || (scalar && scalarAddr != sseAddr))
+      fprintf(stderr, "address: scalar and SSE2 parsers disagree on \"%.*s\"\n", int(text.size()), first);
+  }
+#endif
+}
+
+void parse_quad_scalar(bench_output& out, const char* name, std::string_view text) {
+  for (bench_run r(out, name); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      uint32_t addr;
+      const char* rv = network_address_detail::parse_dotted_quad_scalar(text.data(), text.data() + text.size(), addr);
+      bench_keep(rv);
+      bench_keep(addr);
+    }
+  }
+}
+
+}
+
+void bench_address(bench_output& out) {
+  check_dotted_quad();
+  parse(out, "address_parse_v4", "192.168.100.200");
+  parse(out, "address_parse_v4_port", "192.168.100.200:8080");
+  parse_quad_scalar(out, "address_parse_v4_scalar", "192.168.100.200");
+  pton(out, "address_parse_v4_inet_pton_baseline", AF_INET, "192.168.100.200");
+  parse(out, "address_parse_v6", "2001:db8::8a2e:370:7334");
+  parse(out, "address_parse_v6_port", "[2001:db8::8a2e:370:7334]:443");
+  pton(out, "address_parse_v6_inet_pton_baseline", AF_INET6, "2001:db8::8a2e:370:7334");
+  format(out, "address_format_v4", "192.168.100.200");
+  format(out, "address_format_v4_port", "192.168.100.200:8080");
+  ntop(out, "address_format_v4_inet_ntop_baseline", AF_INET, "192.168.100.200");
+  format(out, "address_format_v6", "2001:db8::8a2e:370:7334");
+  format(out, "address_format_v6_port", "[2001:db8::8a2e:370:7334]:443");
+  ntop(out, "address_format_v6_inet_ntop_baseline", AF_INET6, "2001:db8::8a2e:370:7334");
+}
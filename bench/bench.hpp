@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Results are written one per line as tab separated
+//   name  iterations  ns_per_op  mb_per_s
+// with '#' comment lines, so runs can be diffed or loaded into a spreadsheet.
+// Names ending in "_baseline" do the same work with plain syscalls/epoll.
+struct bench_output {
+  FILE* out = nullptr;
+  std::string filter;
+  std::chrono::nanoseconds minTime = std::chrono::milliseconds(200);
+  bool wanted(const std::string& name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+  }
+  void report(const std::string& name, uint64_t iterations, std::chrono::nanoseconds elapsed, uint64_t bytesPerOp);
+};
+
+// Calibrates the iteration count: the loop body runs `iterations` operations,
+// and next() keeps doubling it until one batch takes at least minTime.
+//   for (bench_run r(out, "name"); r.next();)
+//     for (uint64_t n = 0; n < r.iterations; n++) ...
+// The body may co_await, so the same loop works inside a coroutine.
+struct bench_run {
+  bench_run(bench_output& out, std::string name, uint64_t bytesPerOp = 0)
+  : out(out)
+  , name(std::move(name))
+  , bytesPerOp(bytesPerOp)
+  , enabled(out.wanted(this->name))
+  {}
+  bool next() {
+    if (!enabled) return false;
+    auto now = std::chrono::steady_clock::now();
+    if (iterations) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start);
+      if (elapsed >= out.minTime || iterations >= (uint64_t(1) << 40)) {
+        out.report(name, iterations, elapsed, bytesPerOp);
+        return false;
+      }
+      // Aim a bit past minTime so most benchmarks finish in one more batch.
+      double scale = elapsed.count() ? 1.4 * out.minTime.count() / elapsed.count() : 100;
+      iterations = std::max<uint64_t>(iterations * 2, std::min(iterations * 100, uint64_t(iterations * scale)));
+    } else {
+      iterations = 1;
+    }
+    start = std::chrono::steady_clock::now();
+    return true;
+  }
+  bench_output& out;
+  std::string name;
+  uint64_t bytesPerOp;
+  bool enabled;
+  uint64_t iterations = 0;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Keeps the compiler from optimizing away a value or the stores behind a pointer.
+template <typename T>
+inline void bench_keep(T&& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+void bench_future(bench_output& out);
+void bench_ring(bench_output& out);
+void bench_file(bench_output& out);
+void bench_socket(bench_output& out);
+void bench_address(bench_output& out);
+void bench_checksum(bench_output& out);
+void bench_dns(bench_output& out);
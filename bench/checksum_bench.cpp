@@ -0,0 +1,48 @@
+#include "bench.hpp"
+#include "manto/checksum.hpp"
+#include <array>
+#include <vector>
+
+namespace {
+
+template <typename Hash>
+void hash(bench_output& out, const char* name, size_t size) {
+  std::vector<uint8_t> data(size, 0x5A);
+  for (bench_run r(out, std::string(name) + "_" + std::to_string(size / 1024) + "k", size); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      Hash h;
+      h.update(data);
+      bench_keep(h);
+    }
+  }
+}
+
+// The usual byte-at-a-time table loop.
+void crc32c_bytewise(bench_output& out, size_t size) {
+  std::array<uint32_t, 256> table;
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++)
+      c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+    table[n] = c;
+  }
+  std::vector<uint8_t> data(size, 0x5A);
+  for (bench_run r(out, "crc32c_" + std::to_string(size / 1024) + "k_baseline", size); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      uint32_t crc = ~0u;
+      for (uint8_t b : data)
+        crc = (crc >> 8) ^ table[(crc ^ b) & 0xff];
+      bench_keep(crc);
+    }
+  }
+}
+
+}
+
+void bench_checksum(bench_output& out) {
+  for (size_t size : { 4096, 65536 }) {
+    hash<crc32c>(out, "crc32c", size);
+    crc32c_bytewise(out, size);
+    hash<xxhash64>(out, "xxhash64", size);
+  }
+}
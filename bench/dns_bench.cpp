@@ -0,0 +1,111 @@
+#include "bench.hpp"
+#include "manto/dns_resolver.hpp"
+#include <cstring>
+#include <vector>
+
+// dns_resolver against a stub server on loopback, on the same ring. The stub
+// answers every A query with 192.0.2.1 and every AAAA query with no records,
+// using the TTL it was started with.
+namespace {
+
+network_address local_address(int fd) {
+  network_address addr;
+  addr.resize(sizeof(sockaddr_in6));
+  getsockname(fd, addr.sockaddr(), &addr.length());
+  return addr;
+}
+
+// Turns a query into its response in place, returning the response length or
+// 0 to ignore it.
+size_t stub_answer(uint8_t* msg, size_t length, size_t capacity, uint32_t ttl) {
+  size_t pos = 12;
+  while (pos < length && msg[pos]) pos += 1 + msg[pos];
+  pos++;
+  if (length < 12 || pos + 4 > length || capacity < pos + 20) return 0;
+  uint16_t qtype = (msg[pos] << 8) | msg[pos + 1];
+  pos += 4;
+  bool answer = qtype == dns_resolver::type_a;
+  uint8_t header[] = { 0x81, 0x80, 0, 1, 0, uint8_t(answer), 0, 0, 0, 0 };
+  memcpy(msg + 2, header, sizeof(header));
+  if (!answer) return pos;
+  uint8_t record[] = { 0xC0, 12, 0, 1, 0, 1, uint8_t(ttl >> 24), uint8_t(ttl >> 16), uint8_t(ttl >> 8), uint8_t(ttl), 0, 4, 192, 0, 2, 1 };
+  memcpy(msg + pos, record, sizeof(record));
+  return pos + sizeof(record);
+}
+
+// An empty datagram stops it.
+future<Void> stub_server(udp_socket& s, uint32_t ttl) {
+  for (;;) {
+    auto msg = co_await s.recvmsg(512);
+    if (!msg || msg->second.empty()) break;
+    std::vector<uint8_t>& data = msg->second;
+    size_t length = data.size();
+    data.resize(512);
+    length = stub_answer(data.data(), length, data.size(), ttl);
+    if (length) (void)co_await s.sendmsg(msg->first, {data.data(), length});
+  }
+  co_return {};
+}
+
+future<Void> resolve_one(dns_resolver& resolver, size_t& answered) {
+  std::vector<network_address> addresses = co_await resolver.resolve("stub.example", 80);
+  if (!addresses.empty()) answered++;
+  co_return {};
+}
+
+future<Void> stop(network_address server) {
+  udp_socket s(0, server.family());
+  (void)co_await s.sendmsg(server, {});
+  co_return {};
+}
+
+// `cached` answers with a TTL of 300 seconds, `uncached` with 0.
+future<Void> resolve_client(bench_output& out, network_address cached, network_address uncached, bool& failed) {
+  size_t answered = 0, expected = 0;
+  {
+    dns_resolver resolver({ cached });
+    for (bench_run r(out, "dns_resolve_uncached"); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++) {
+        resolver.clear_cache();
+        co_await resolve_one(resolver, answered);
+      }
+      expected += r.iterations;
+    }
+    for (bench_run r(out, "dns_resolve_cached"); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++)
+        co_await resolve_one(resolver, answered);
+      expected += r.iterations;
+    }
+  }
+  {
+    // Sixteen lookups of one name sharing a query. With a TTL of 0 the answer
+    // never enters the cache, so the joiners depend on coalescing alone.
+    dns_resolver resolver({ uncached });
+    for (bench_run r(out, "dns_resolve_coalesced_16"); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++) {
+        std::vector<future<Void>> lookups;
+        for (int k = 0; k < 16; k++)
+          lookups.push_back(resolve_one(resolver, answered));
+        for (auto& f : lookups)
+          co_await f;
+      }
+      expected += 16 * r.iterations;
+    }
+  }
+  failed = answered != expected;
+  co_await stop(cached);
+  co_await stop(uncached);
+  co_return {};
+}
+
+}
+
+void bench_dns(bench_output& out) {
+  udp_socket cached(network_address("127.0.0.1:0")), uncached(network_address("127.0.0.1:0"));
+  bool failed = false;
+  future<Void> stub1 = stub_server(cached, 300);
+  future<Void> stub2 = stub_server(uncached, 0);
+  future<Void> client = resolve_client(out, local_address(cached.fd), local_address(uncached.fd), failed);
+  async_run();
+  if (failed) fprintf(stderr, "dns: some lookups got no answer from the stub server\n");
+}
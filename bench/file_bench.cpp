@@ -0,0 +1,70 @@
+#include "bench.hpp"
+#include "manto/file.hpp"
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t fileSize = 64 << 20;
+
+// One of `stride` workers: reads every stride-th block from `start` on,
+// wrapping around at the end of the file.
+future<Void> reader(file& f, size_t block, uint64_t start, uint64_t count, uint64_t stride) {
+  std::vector<uint8_t> buffer(block);
+  size_t blocks = fileSize / block;
+  for (uint64_t n = 0; n < count; n++) {
+    result<size_t> rv = co_await f.read(buffer.data(), block, ((start + n * stride) % blocks) * block);
+    bench_keep(rv);
+  }
+  co_return {};
+}
+
+void read_depth(bench_output& out, file& f, size_t block, size_t depth) {
+  for (bench_run r(out, "file_read_" + std::to_string(block / 1024) + "k_qd" + std::to_string(depth), block); r.next();) {
+    std::vector<future<Void>> workers;
+    for (size_t n = 0; n < depth; n++)
+      workers.push_back(reader(f, block, n, (r.iterations + depth - 1 - n) / depth, depth));
+    async_run();
+  }
+}
+
+void pread_baseline(bench_output& out, int fd, size_t block) {
+  std::vector<uint8_t> buffer(block);
+  size_t blocks = fileSize / block;
+  for (bench_run r(out, "pread_" + std::to_string(block / 1024) + "k_baseline", block); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      ssize_t rv = pread(fd, buffer.data(), block, (n % blocks) * block);
+      bench_keep(rv);
+    }
+  }
+}
+
+}
+
+// Reads a page-cached temporary file, so this measures the submission path
+// rather than the disk.
+void bench_file(bench_output& out) {
+  char path[] = "/tmp/manto_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return;
+  }
+  unlink(path);
+  std::vector<uint8_t> chunk(1 << 20, 0x5A);
+  for (size_t n = 0; n < fileSize; n += chunk.size()) {
+    if (write(fd, chunk.data(), chunk.size()) != (ssize_t)chunk.size()) {
+      perror("write");
+      close(fd);
+      return;
+    }
+  }
+  file f(fd);
+  for (size_t block : { 4096, 65536 }) {
+    pread_baseline(out, fd, block);
+    for (size_t depth : { 1, 4, 16 })
+      read_depth(out, f, block, depth);
+  }
+}
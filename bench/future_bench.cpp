@@ -0,0 +1,71 @@
+#include "bench.hpp"
+#include "manto/future.hpp"
+
+namespace {
+
+__attribute__((noinline)) int call(int v) {
+  bench_keep(v);
+  return v;
+}
+
+future<int> ready(int v) {
+  co_return v;
+}
+
+future<int> chain(int depth) {
+  if (depth == 0) co_return 1;
+  co_return 1 + co_await chain(depth - 1);
+}
+
+// Parks the awaiting coroutine in a slot for the driver loop to resume.
+struct parked {
+  std::coroutine_handle<>& slot;
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> h) { slot = h; }
+  void await_resume() {}
+};
+
+future<int> child(std::coroutine_handle<>& slot) {
+  co_await parked{slot};
+  co_return 1;
+}
+
+future<int> parent(std::coroutine_handle<>& slot, uint64_t iterations) {
+  int sum = 0;
+  for (uint64_t n = 0; n < iterations; n++)
+    sum += co_await child(slot);
+  co_return sum;
+}
+
+future<Void> awaits(bench_output& out) {
+  for (bench_run r(out, "future_create_await_ready"); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      int v = co_await ready(n);
+      bench_keep(v);
+    }
+  }
+  for (bench_run r(out, "future_chain_depth_8"); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      int v = co_await chain(8);
+      bench_keep(v);
+    }
+  }
+  co_return {};
+}
+
+}
+
+void bench_future(bench_output& out) {
+  for (bench_run r(out, "function_call_baseline"); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++)
+      bench_keep(call(n));
+  }
+  future<Void> f = awaits(out);
+  // Suspends in a child coroutine and resumes through it back into the parent.
+  for (bench_run r(out, "future_suspend_resume"); r.next();) {
+    std::coroutine_handle<> slot;
+    future<int> p = parent(slot, r.iterations);
+    while (slot)
+      std::exchange(slot, {}).resume();
+  }
+}
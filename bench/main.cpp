@@ -0,0 +1,44 @@
+#include "bench.hpp"
+#include <cstring>
+
+void bench_output::report(const std::string& name, uint64_t iterations, std::chrono::nanoseconds elapsed, uint64_t bytesPerOp) {
+  double nsPerOp = double(elapsed.count()) / iterations;
+  double mbPerSec = bytesPerOp ? bytesPerOp * 1e3 / nsPerOp : 0;
+  printf("%-40s %12llu %12.1f ns/op", name.c_str(), (unsigned long long)iterations, nsPerOp);
+  if (bytesPerOp) printf(" %10.1f MB/s", mbPerSec);
+  printf("\n");
+  fflush(stdout);
+  if (out) {
+    fprintf(out, "%s\t%llu\t%.1f\t%.1f\n", name.c_str(), (unsigned long long)iterations, nsPerOp, mbPerSec);
+    fflush(out);
+  }
+}
+
+// manto_bench [output file] [--filter substring] [--min-time ms]
+int main(int argc, char** argv) {
+  bench_output out;
+  const char* path = "bench_output.txt";
+  for (int n = 1; n < argc; n++) {
+    if (strcmp(argv[n], "--filter") == 0 && n + 1 < argc) {
+      out.filter = argv[++n];
+    } else if (strcmp(argv[n], "--min-time") == 0 && n + 1 < argc) {
+      out.minTime = std::chrono::milliseconds(atoi(argv[++n]));
+    } else {
+      path = argv[n];
+    }
+  }
+  out.out = fopen(path, "w");
+  if (!out.out) {
+    perror(path);
+    return 1;
+  }
+  fprintf(out.out, "# name\titerations\tns_per_op\tmb_per_s\n");
+  bench_future(out);
+  bench_ring(out);
+  bench_file(out);
+  bench_socket(out);
+  bench_address(out);
+  bench_checksum(out);
+  bench_dns(out);
+  fclose(out.out);
+}
@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include "manto/async_syscall.hpp"
+#include "manto/future.hpp"
+#include <sys/syscall.h>
+
+namespace {
+
+future<Void> nops(bench_output& out) {
+  for (bench_run r(out, "ring_nop_roundtrip"); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++) {
+      int v = co_await async_nop();
+      bench_keep(v);
+    }
+  }
+  // Eight requests per submit; reported per request.
+  constexpr size_t batch = 8;
+  for (bench_run r(out, "ring_nop_batch8"); r.next();) {
+    syscall_rv_base rvs[batch];
+    for (uint64_t n = 0; n < r.iterations; n += batch) {
+      for (auto& rv : rvs) {
+        io_uring_sqe* s = get_ring().get_sqe();
+        io_uring_prep_nop(s);
+        rv.attach(s);
+      }
+      for (auto& rv : rvs)
+        co_await rv;
+    }
+  }
+  co_return {};
+}
+
+}
+
+void bench_ring(bench_output& out) {
+  for (bench_run r(out, "syscall_getppid_baseline"); r.next();) {
+    for (uint64_t n = 0; n < r.iterations; n++)
+      bench_keep(syscall(SYS_getppid));
+  }
+  future<Void> f = nops(out);
+  async_run();
+}
@@ -0,0 +1,197 @@
+#include "bench.hpp"
+#include "manto/tcp_socket.hpp"
+#include "manto/udp_socket.hpp"
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+// Ping-pong over loopback on a single thread, so each round trip is a send
+// and a receive on both ends. The baselines do the same with nonblocking
+// sockets and epoll.
+namespace {
+
+network_address local_address(int fd) {
+  network_address addr;
+  addr.resize(sizeof(sockaddr_in6));
+  getsockname(fd, addr.sockaddr(), &addr.length());
+  return addr;
+}
+
+future<Void> tcp_echo(tcp_socket s) {
+  std::vector<uint8_t> buffer(65536);
+  for (;;) {
+    result<size_t> bytes = co_await s.recvmsg(buffer.data(), buffer.size());
+    if (!bytes || *bytes == 0) break;
+    if (!co_await s.sendmsg({buffer.data(), *bytes})) break;
+  }
+  co_return {};
+}
+
+future<Void> tcp_pingpong(bench_output& out, tcp_socket& s) {
+  for (size_t size : { 64, 16384 }) {
+    std::vector<uint8_t> msg(size, 0x5A), reply(size);
+    for (bench_run r(out, "tcp_echo_" + std::to_string(size), size); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++) {
+        if (!co_await s.sendmsg(msg)) co_return {};
+        for (size_t got = 0; got < size;) {
+          result<size_t> bytes = co_await s.recvmsg(reply.data() + got, size - got);
+          if (!bytes || *bytes == 0) co_return {};
+          got += *bytes;
+        }
+      }
+    }
+  }
+  co_return {};
+}
+
+future<Void> tcp_client(bench_output& out, network_address server, int listenFd) {
+  {
+    result<tcp_socket> s = co_await tcp_socket::create(server);
+    if (s) co_await tcp_pingpong(out, *s);
+  }
+  shutdown(listenFd, SHUT_RDWR);
+  co_return {};
+}
+
+future<Void> udp_echo(udp_socket& s) {
+  for (;;) {
+    auto msg = co_await s.recvmsg(65536);
+    if (!msg || msg->second.empty()) break;
+    (void)co_await s.sendmsg(msg->first, msg->second);
+  }
+  co_return {};
+}
+
+future<Void> udp_client(bench_output& out, udp_socket& s, network_address server) {
+  for (size_t size : { 64, 1400 }) {
+    std::vector<uint8_t> msg(size, 0x5A);
+    for (bench_run r(out, "udp_echo_" + std::to_string(size), size); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++) {
+        (void)co_await s.sendmsg(server, msg);
+        auto reply = co_await s.recvmsg(65536);
+        bench_keep(reply);
+      }
+    }
+  }
+  // An empty datagram stops the echo loop.
+  (void)co_await s.sendmsg(server, {});
+  co_return {};
+}
+
+void wait_readable(int epfd) {
+  epoll_event ev;
+  while (epoll_wait(epfd, &ev, 1, -1) < 1) {}
+}
+
+void set_nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// Reads exactly `size` bytes, waiting on `epfd` whenever the socket runs dry.
+bool read_full(int fd, int epfd, uint8_t* p, size_t size) {
+  for (size_t got = 0; got < size;) {
+    ssize_t bytes = read(fd, p + got, size - got);
+    if (bytes > 0) {
+      got += bytes;
+    } else if (bytes < 0 && errno == EAGAIN) {
+      wait_readable(epfd);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Blocking writes; loopback buffers are far larger than the messages.
+void write_full(int fd, const uint8_t* p, size_t size) {
+  for (size_t sent = 0; sent < size;) {
+    ssize_t bytes = write(fd, p + sent, size - sent);
+    if (bytes > 0) sent += bytes;
+  }
+}
+
+int epoll_for(int fd) {
+  int epfd = epoll_create1(0);
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+  return epfd;
+}
+
+void tcp_epoll_baseline(bench_output& out) {
+  int listenFd = tcp_listen_socket::listen_fd(network_address("127.0.0.1:0"));
+  network_address server = local_address(listenFd);
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  connect(client, server.sockaddr(), server.length());
+  int peer = accept(listenFd, nullptr, nullptr);
+  close(listenFd);
+  set_nonblocking(client);
+  set_nonblocking(peer);
+  int clientEp = epoll_for(client), peerEp = epoll_for(peer);
+  for (size_t size : { 64, 16384 }) {
+    std::vector<uint8_t> msg(size, 0x5A), buffer(size);
+    for (bench_run r(out, "tcp_echo_" + std::to_string(size) + "_epoll_baseline", size); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++) {
+        write_full(client, msg.data(), size);
+        read_full(peer, peerEp, buffer.data(), size);
+        write_full(peer, buffer.data(), size);
+        read_full(client, clientEp, buffer.data(), size);
+      }
+    }
+  }
+  close(clientEp);
+  close(peerEp);
+  close(client);
+  close(peer);
+}
+
+void udp_epoll_baseline(bench_output& out) {
+  udp_socket server(network_address("127.0.0.1:0")), client(network_address("127.0.0.1:0"));
+  network_address serverAddr = local_address(server.fd);
+  set_nonblocking(server.fd);
+  set_nonblocking(client.fd);
+  int serverEp = epoll_for(server.fd), clientEp = epoll_for(client.fd);
+  std::vector<uint8_t> buffer(65536);
+  for (size_t size : { 64, 1400 }) {
+    std::vector<uint8_t> msg(size, 0x5A);
+    for (bench_run r(out, "udp_echo_" + std::to_string(size) + "_epoll_baseline", size); r.next();) {
+      for (uint64_t n = 0; n < r.iterations; n++) {
+        sendto(client.fd, msg.data(), size, 0, serverAddr.sockaddr(), serverAddr.length());
+        network_address from;
+        from.resize(sizeof(sockaddr_in6));
+        ssize_t bytes;
+        while ((bytes = recvfrom(server.fd, buffer.data(), buffer.size(), 0, from.sockaddr(), &from.length())) < 0)
+          wait_readable(serverEp);
+        sendto(server.fd, buffer.data(), bytes, 0, from.sockaddr(), from.length());
+        while (recv(client.fd, buffer.data(), buffer.size(), 0) < 0)
+          wait_readable(clientEp);
+      }
+    }
+  }
+  close(serverEp);
+  close(clientEp);
+}
+
+}
+
+void bench_socket(bench_output& out) {
+  {
+    int listenFd = tcp_listen_socket::listen_fd(network_address("127.0.0.1:0"));
+    network_address server = local_address(listenFd);
+    std::vector<future<Void>> connections;
+    tcp_listen_socket listener(listenFd, [&](tcp_socket s) {
+      connections.push_back(tcp_echo(std::move(s)));
+    });
+    future<Void> client = tcp_client(out, server, listenFd);
+    async_run();
+  }
+  tcp_epoll_baseline(out);
+  {
+    udp_socket server(network_address("127.0.0.1:0")), client(network_address("127.0.0.1:0"));
+    future<Void> echo = udp_echo(server);
+    future<Void> pinger = udp_client(out, client, local_address(server.fd));
+    async_run();
+  }
+  udp_epoll_baseline(out);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "manto/coroutine_frames.hpp"
+#include "manto/result.hpp"
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// A coroutine that produces a sequence of values over time. Its body can
+// co_await futures and syscalls between co_yields, and the consumer pulls
+// values with co_await next(). Control passes directly between the two, so a
+// stream of chunks costs one frame for the whole stream rather than one per
+// chunk. Yielded values are referenced, not copied, and stay valid until the
+// next call to next().
+//
+//   async_generator<std::span<const uint8_t>> chunks = sock.stream(buffer);
+//   while (co_await chunks.next())
+//     consume(chunks.value());
+//
+// `co_yield errno_error{...}` ends the sequence with that error, see error().
+// The body only runs while the consumer waits in next(), so a generator the
+// consumer drops is never suspended on I/O.
+template <typename T>
+struct async_generator {
+  struct promise_type;
+  using handle_type = std::coroutine_handle<promise_type>;
+  using value_type = std::remove_reference_t<T>;
+
+  struct promise_type : counted_frame {
+    value_type* current = nullptr;
+    std::coroutine_handle<> consumer;
+    int error = 0;
+    bool finished = false;
+
+    // Hands control back to the consumer waiting in next().
+    struct to_consumer {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(handle_type h) noexcept { return h.promise().consumer; }
+      void await_resume() noexcept {}
+    };
+    async_generator get_return_object() {
+      return async_generator(handle_type::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() {
+      return {};
+    }
+    to_consumer final_suspend() noexcept {
+      finished = true;
+      current = nullptr;
+      return {};
+    }
+    to_consumer yield_value(value_type& value) {
+      current = std::addressof(value);
+      return {};
+    }
+    to_consumer yield_value(value_type&& value) {
+      current = std::addressof(value);
+      return {};
+    }
+    to_consumer yield_value(errno_error e) {
+      error = e.code;
+      finished = true;
+      current = nullptr;
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception() {
+      std::terminate();
+    }
+  };
+
+  struct next_awaiter {
+    handle_type coro;
+    bool await_ready() {
+      return !coro || coro.promise().finished;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) {
+      coro.promise().consumer = consumer;
+      return coro;
+    }
+    bool await_resume() {
+      return coro && !coro.promise().finished;
+    }
+  };
+
+  async_generator() = default;
+  explicit async_generator(handle_type h)
+  : coro(h)
+  {}
+  async_generator(async_generator&& rhs)
+  : coro(std::exchange(rhs.coro, {}))
+  {}
+  async_generator& operator=(async_generator&& rhs) {
+    if (this != &rhs) {
+      if (coro) coro.destroy();
+      coro = std::exchange(rhs.coro, {});
+    }
+    return *this;
+  }
+  ~async_generator() {
+    if (coro) coro.destroy();
+  }
+  // Runs the body up to its next co_yield; true if it produced a value, false
+  // once it has finished.
+  next_awaiter next() {
+    return {coro};
+  }
+  // The value from the last successful next().
+  value_type& value() {
+    return *coro.promise().current;
+  }
+  // The errno the sequence ended with, 0 if it ended normally or has not ended.
+  int error() const {
+    return coro ? coro.promise().error : 0;
+  }
+private:
+  handle_type coro;
+};
@@ -4,28 +4,79 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <liburing.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cstdio>
+#include <iterator>
+#include <utility>
+#include "manto/coroutine_frames.hpp"
+#include "manto/trace.hpp"
+#ifdef MANTO_RING_STATS
+#include "manto/ring_stats.hpp"
+#endif
+
+template <typename T>
+struct syscall_awaiter;
 
 struct syscall_rv_base {
     std::coroutine_handle<> awaiting = {};
     int32_t rv = -1;
     bool done = false;
+    // The awaiting coroutine's ring_priority, see ring_config::budget.
+    uint8_t priority = 1;
     io_uring_sqe* sqe = nullptr;
-    void signal(int32_t value) {
-        this->rv = value;
-        if (awaiting) 
-          std::move(awaiting).resume();
-        else 
-          done = true;
+    syscall_rv_base* nextReady = nullptr;
+#ifdef MANTO_RING_STATS
+    uint8_t opcode = 0;
+    uint64_t prepared = 0;
+#endif
+    syscall_rv_base() = default;
+    syscall_rv_base(const syscall_rv_base&) = delete;
+    void signal(int32_t value);
+    // Resumes `h` once signalled, in the priority class it is running in now.
+    void set_awaiting(std::coroutine_handle<> h);
+    // Points a prepared SQE at this completion, for callers that keep many
+    // requests in flight from one coroutine.
+    void attach(io_uring_sqe* s) {
+        sqe = s;
+        done = false;
+        s->user_data = (uintptr_t)this;
+        stamp();
     }
-    void cancel() {
-        if (sqe) {
-            // cancel?
-            // IORING_OP_ASYNC_CANCEL            
-        }
+    void stamp() {
+        trace_record(trace_kind::op_begin, this, nullptr, 0, sqe->opcode);
+#ifdef MANTO_RING_STATS
+        opcode = sqe->opcode;
+        prepared = ring_stats::now();
+#endif
+    }
+    void cancel();
+    syscall_awaiter<int32_t> operator co_await();
+};
+
+// Refers to the completion instead of being it, as GCC copies lvalue awaiters.
+template <typename T>
+struct syscall_awaiter {
+    syscall_rv_base* b;
+    bool await_ready() {
+        return b->done;
+    }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        trace_record(trace_kind::await_begin, awaiting.address(), b, 0, b->sqe ? b->sqe->opcode : 0);
+        b->set_awaiting(awaiting);
+    }
+    T await_resume() {
+        return (T)b->rv;
     }
 };
 
+inline syscall_awaiter<int32_t> syscall_rv_base::operator co_await() {
+    return {this};
+}
+
 template <typename T>
 struct syscall_rv : public syscall_rv_base {
     syscall_rv(int32_t value) {
@@ -35,19 +86,14 @@ struct syscall_rv : public syscall_rv_base {
     {
         sqe = s;
         s->user_data = (uintptr_t)(syscall_rv_base*)this;
+        stamp();
     }
     syscall_rv(syscall_rv<T>&& o) = delete;
     const syscall_rv& operator=(syscall_rv<T>&& o) = delete;
     ~syscall_rv() {
     }
-    bool await_ready() {
-        return done;
-    }
-    void await_suspend(std::coroutine_handle<> awaiting) {
-        this->awaiting = awaiting;
-    }
-    auto await_resume() {
-        return (T)std::move(rv);
+    syscall_awaiter<T> operator co_await() {
+        return {this};
     }
 };
 /*
@@ -67,35 +113,362 @@ struct cancellation_token {
     }
 };
 */
+// Classes for the ready queue, most urgent first. A coroutine runs in the
+// class of whatever resumed it until it calls set_priority().
+enum class ring_priority : uint8_t {
+  critical,
+  normal,
+  bulk,
+};
+
+// Load a ring takes on before async_admit() makes new work wait and
+// try_admit() turns it away. 0 means no limit.
+struct ring_limits {
+  // Requests in flight, counting coroutines parked on sync primitives.
+  size_t operations = 0;
+  // Bytes handed to sends that have not completed yet.
+  size_t sendBytes = 0;
+  // Live coroutine frames on the ring's thread.
+  size_t frames = 0;
+};
+
+// See async_admit().
+struct admit_awaiter {
+  explicit admit_awaiter(size_t sendBytes)
+  : sendBytes(sendBytes)
+  {}
+  bool await_ready();
+  void await_suspend(std::coroutine_handle<> awaiting);
+  void await_resume() {}
+  size_t sendBytes;
+  syscall_rv_base b;
+  admit_awaiter* next = nullptr;
+};
+
+// How rings are created; change it before the threads that use it do any I/O.
+struct ring_config {
+  // SQ size. Requests beyond it are handed to the kernel as the SQ fills, so
+  // batches larger than this cost one io_uring_enter per SQ's worth.
+  unsigned entries = 8;
+  // IORING_SETUP_* flags, none by default. A ring is only ever used by the
+  // thread that owns it, so low_latency_flags are always safe to opt into;
+  // kernels too old for some of them get the rest.
+  unsigned flags = 0;
+  // How long to spin on the CQ before sleeping in the kernel; 0 never spins.
+  std::chrono::nanoseconds busyPoll{0};
+  // How many coroutines to resume before polling the CQ again. With 0 each one
+  // resumes straight from the CQE loop. Otherwise completions queue up by
+  // ring_priority and the most urgent run first, so a connection with a lot
+  // of completions cannot hold up control traffic on the same thread.
+  unsigned budget = 0;
+  ring_limits limits;
+  static constexpr unsigned low_latency_flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN;
+};
+
+inline ring_config& default_ring_config() {
+  static ring_config config;
+  return config;
+}
+
 struct kernel_ring {
-  kernel_ring() {
-    if (io_uring_queue_init(8, &ring, 0) < 0) throw 42;
+  kernel_ring(const ring_config& config = default_ring_config()) {
+    int rv = -EINVAL;
+    flags = config.flags;
+    // Newest flags first: DEFER_TASKRUN is 6.1, SINGLE_ISSUER 6.0, COOP_TASKRUN 5.19.
+    for (unsigned unsupported : { 0u, unsigned(IORING_SETUP_DEFER_TASKRUN), unsigned(IORING_SETUP_SINGLE_ISSUER), unsigned(IORING_SETUP_COOP_TASKRUN) }) {
+      flags &= ~unsupported;
+      rv = io_uring_queue_init(config.entries, &ring, flags);
+      if (rv != -EINVAL) break;
+    }
+    if (rv < 0) throw 42;
+    busyPoll = spinWindow = config.busyPoll;
+    budget = config.budget;
+    limits = config.limits;
   }
   io_uring_sqe* get_sqe() {
+    io_uring_sqe* s = io_uring_get_sqe(&ring);
+    if (!s) {
+      // SQ is full; hand what we have to the kernel to make room
+#ifdef MANTO_RING_STATS
+      stats.sqFull++;
+#endif
+      io_uring_submit(&ring);
+      s = io_uring_get_sqe(&ring);
+    }
     outstanding_requests++;
-    return io_uring_get_sqe(&ring);
+    return s;
   }
+  // Makes sure the next n SQEs go out in the same submit, for linked requests.
+  void reserve(unsigned n) {
+    if (io_uring_sq_space_left(&ring) < n) 
+      io_uring_submit(&ring);
+  }
+  // Runs until nothing is in flight or ready.
   void run() {
-    while (outstanding_requests) {
-      io_uring_submit_and_wait(&ring, 1);
-      io_uring_cqe* cqe;
-      while (outstanding_requests && io_uring_peek_cqe(&ring, &cqe) == 0) {
-        outstanding_requests--;
-        syscall_rv_base* b = (syscall_rv_base*)cqe->user_data;
-        b->signal(cqe->res);
-        io_uring_cqe_seen(&ring,cqe);
+    while (outstanding_requests || readyCount)
+      run_once();
+  }
+  // Submits, waits for at least one completion (unless coroutines are already
+  // ready) and handles all that are ready, then runs up to `budget` ready
+  // coroutines. Returns how many were handled, 0 if there was nothing to do.
+  unsigned run_once() {
+    if (!outstanding_requests && !readyCount) return 0;
+    admit_waiting();
+    poll(nullptr);
+    unsigned handled = reap();
+    return handled + run_ready();
+  }
+  // Like run(), but hands the thread back once `duration` has passed.
+  void run_for(std::chrono::nanoseconds duration) {
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    while (outstanding_requests || readyCount) {
+      auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+      if (left <= 0) break;
+      admit_waiting();
+      __kernel_timespec ts = { left / 1000000000, left % 1000000000 };
+      poll(&ts);
+      reap();
+      run_ready();
+    }
+  }
+  // Runs until `f` (a future or anything else with await_ready) is ready.
+  // Returns false if it cannot get there because nothing is in flight.
+  template <typename Awaitable>
+  bool run_until(Awaitable& f) {
+    while (!f.await_ready()) {
+      if (!outstanding_requests && !readyCount) return false;
+      run_once();
+    }
+    return true;
+  }
+  // An eventfd that becomes readable whenever completions are waiting, for
+  // driving the ring from an epoll/libev loop instead of run(). Created and
+  // registered on first use; -1 if that fails.
+  int event_fd() {
+    if (eventFd == -1) {
+      eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (eventFd != -1 && io_uring_register_eventfd(&ring, eventFd) < 0) {
+        close(eventFd);
+        eventFd = -1;
+      }
+    }
+    return eventFd;
+  }
+  // Handles whatever has completed without blocking, then submits the requests
+  // that the resumed coroutines queued. Call it when event_fd() is readable and
+  // after starting new work from outside a coroutine. Only the ring's own thread
+  // may call this; another thread can still be the one watching event_fd().
+  unsigned poll_completions() {
+    if (eventFd != -1) {
+      uint64_t count;
+      // Reset first, so completions from here on signal the fd again.
+      while (read(eventFd, &count, sizeof(count)) == -1 && errno == EINTR) {}
+    }
+    io_uring_submit(&ring);
+    if (flags & IORING_SETUP_DEFER_TASKRUN) io_uring_get_events(&ring);
+    unsigned handled = reap();
+    handled += run_ready();
+    admit_waiting();
+    // Over budget: come back soon for the rest.
+    if (readyCount && eventFd != -1) {
+      uint64_t one = 1;
+      (void)!write(eventFd, &one, sizeof(one));
+    }
+    io_uring_submit(&ring);
+    return handled;
+  }
+  // Handles every CQE that is ready. They are copied out a batch at a time
+  // and handed back with one CQ head update before any coroutine resumes. A
+  // resumed coroutine may run the ring itself (run_until, a blocking helper);
+  // its reap() carries on with the rest of the batch, so every CQE is handled
+  // exactly once. Without a budget, completions that arrive while resumed
+  // coroutines run are picked up in the same pass.
+  unsigned reap() {
+#ifdef MANTO_RING_STATS
+    uint64_t now = ring_stats::now();
+#endif
+    unsigned count = 0;
+    for (;;) {
+      if (reaped.next == reaped.end) {
+        unsigned head, n = 0;
+        io_uring_cqe* cqe;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+          reaped.cqes[n++] = { cqe->user_data, cqe->res };
+          if (n == std::size(reaped.cqes)) break;
+        }
+        if (!n) break;
+        io_uring_cq_advance(&ring, n);
+        reaped.next = 0;
+        reaped.end = n;
       }
+      auto [userData, res] = reaped.cqes[reaped.next++];
+      count++;
+      // liburing's own timeout for run_for on kernels without EXT_ARG
+      if (userData == LIBURING_UDATA_TIMEOUT) continue;
+      outstanding_requests--;
+      syscall_rv_base* b = (syscall_rv_base*)userData;
+#ifdef MANTO_RING_STATS
+      if (b) stats.record_completion(b->opcode, now - b->prepared);
+#endif
+      if (b) b->signal(res);
     }
+#ifdef MANTO_RING_STATS
+    stats.cqeBatch.record(count);
+#endif
+    return count;
   }
+#ifdef MANTO_RING_STATS
+  // Copy of the counters so far; call from the ring's own thread.
+  ring_stats snapshot() const {
+    return stats;
+  }
+  void reset_stats() {
+    stats = {};
+  }
+  ring_stats stats;
+#endif
   ~kernel_ring() {
     io_uring_queue_exit(&ring);
+    if (eventFd != -1) close(eventFd);
+  }
+  // Resumes the coroutine waiting on `b` now or, with a budget, queues it.
+  void make_ready(syscall_rv_base* b) {
+    if (!budget) {
+      resume(b);
+      return;
+    }
+    ready_queue& q = ready[b->priority];
+    b->nextReady = nullptr;
+    *q.tail = b;
+    q.tail = &b->nextReady;
+    readyCount++;
+  }
+  // Resumes up to `budget` queued coroutines, most urgent class first.
+  unsigned run_ready() {
+    unsigned ran = 0;
+    while (readyCount && ran < budget) {
+      ready_queue* q = ready;
+      while (!q->head) q++;
+      syscall_rv_base* b = q->head;
+      q->head = b->nextReady;
+      if (!q->head) q->tail = &q->head;
+      readyCount--;
+      resume(b);
+      ran++;
+    }
+    return ran;
+  }
+  // Whether the ring is at one of its limits, or would be after `sendBytes`
+  // more. A send on its own always fits, however large.
+  bool overloaded(size_t sendBytes = 0) const {
+    return (limits.operations && outstanding_requests - admitting.count >= limits.operations)
+        || (limits.sendBytes && pendingSendBytes && pendingSendBytes + sendBytes > limits.sendBytes)
+        || (limits.frames && live_frames().count >= limits.frames);
+  }
+  // Queues `a` until the ring has room for it, in arrival order. It counts as
+  // in flight meanwhile, so run() keeps going.
+  void wait_for_capacity(admit_awaiter* a) {
+    a->next = nullptr;
+    *admitting.tail = a;
+    admitting.tail = &a->next;
+    admitting.count++;
+    outstanding_requests++;
   }
   void handle_cqe(io_uring_cqe* c) {
     syscall_rv_base* base = (syscall_rv_base*)c->user_data;
     base->signal(c->res);
   }
   struct io_uring ring;
+  // The setup flags the kernel accepted.
+  unsigned flags = 0;
   size_t outstanding_requests = 0;
+  // Bytes in sends that have not completed, see pending_send.
+  size_t pendingSendBytes = 0;
+  std::chrono::nanoseconds busyPoll{0};
+  unsigned budget = 0;
+  ring_limits limits;
+  // The class of the coroutine running now.
+  ring_priority priority = ring_priority::normal;
+private:
+  struct ready_queue {
+    syscall_rv_base* head = nullptr;
+    syscall_rv_base** tail = &head;
+  };
+  void resume(syscall_rv_base* b) {
+    priority = ring_priority(b->priority);
+    trace_record(trace_kind::await_end, b->awaiting.address());
+    std::exchange(b->awaiting, {}).resume();
+  }
+  // Lets waiting coroutines in while there is room. With a budget, admitted
+  // ones only take up room once they run, so one goes in per pass. When they
+  // are all that is left in flight nothing else can free room, so the first
+  // goes in regardless.
+  void admit_waiting() {
+    while (admit_awaiter* a = admitting.head) {
+      bool stuck = outstanding_requests == admitting.count && !readyCount;
+      if (!stuck && overloaded(a->sendBytes)) break;
+      admitting.head = a->next;
+      if (!admitting.head) admitting.tail = &admitting.head;
+      admitting.count--;
+      outstanding_requests--;
+      a->b.signal(0);
+      if (budget) break;
+    }
+  }
+  // Submits, and only waits for completions when nothing is ready to run.
+  void poll(__kernel_timespec* timeout) {
+    if (!readyCount && reaped.next == reaped.end) {
+      wait(timeout);
+      return;
+    }
+    io_uring_submit(&ring);
+    if (flags & IORING_SETUP_DEFER_TASKRUN) io_uring_get_events(&ring);
+  }
+  // Submits and blocks until a CQE is ready or the relative `timeout` passes.
+  void wait(__kernel_timespec* timeout) {
+#ifdef MANTO_RING_STATS
+    stats.submits++;
+    stats.queueDepth.record(outstanding_requests);
+#endif
+    if (busyPoll.count() && spin()) return;
+    if (timeout) {
+      io_uring_cqe* cqe;
+      io_uring_submit_and_wait_timeout(&ring, &cqe, 1, timeout, nullptr);
+    } else {
+      io_uring_submit_and_wait(&ring, 1);
+    }
+  }
+  // Spins for up to spinWindow waiting for a CQE. The window halves after each
+  // miss and goes back to busyPoll after a hit, so a ring that has gone quiet
+  // soon sleeps in the kernel again while a busy one keeps spinning.
+  bool spin() {
+    io_uring_submit(&ring);
+    auto until = std::chrono::steady_clock::now() + spinWindow;
+    do {
+      // Deferred task work only runs when we enter the kernel for it.
+      if (flags & IORING_SETUP_DEFER_TASKRUN) io_uring_get_events(&ring);
+      if (io_uring_cq_ready(&ring)) {
+        spinWindow = busyPoll;
+        return true;
+      }
+    } while (std::chrono::steady_clock::now() < until);
+    spinWindow = std::max(spinWindow / 2, busyPoll / 16);
+    return false;
+  }
+  std::chrono::nanoseconds spinWindow{0};
+  int eventFd = -1;
+  ready_queue ready[3];
+  size_t readyCount = 0;
+  // CQEs taken off the CQ by reap() and not handled yet.
+  struct {
+    struct { uint64_t userData; int32_t res; } cqes[64];
+    unsigned next = 0, end = 0;
+  } reaped;
+  struct {
+    admit_awaiter* head = nullptr;
+    admit_awaiter** tail = &head;
+    size_t count = 0;
+  } admitting;
 };
 
 inline kernel_ring& get_ring() {
@@ -103,6 +476,94 @@ inline kernel_ring& get_ring() {
   return ring;
 }
 
+inline void syscall_rv_base::signal(int32_t value) {
+    rv = value;
+    done = true;
+    if (sqe) trace_record(trace_kind::op_end, this, nullptr, value);
+    if (awaiting) get_ring().make_ready(this);
+}
+
+inline void syscall_rv_base::set_awaiting(std::coroutine_handle<> h) {
+    awaiting = h;
+    priority = uint8_t(get_ring().priority);
+}
+
+// Puts what the calling coroutine awaits from here on in class `p`.
+inline void set_priority(ring_priority p) {
+  get_ring().priority = p;
+}
+
+// With a budget, sends the caller to the back of its class so other ready
+// coroutines get a turn; without one it carries straight on.
+struct yield_awaiter {
+  bool await_ready() {
+    return !get_ring().budget;
+  }
+  void await_suspend(std::coroutine_handle<> awaiting) {
+    b.set_awaiting(awaiting);
+    get_ring().make_ready(&b);
+  }
+  void await_resume() {}
+  syscall_rv_base b;
+};
+
+inline yield_awaiter async_yield() {
+  return {};
+}
+
+inline bool admit_awaiter::await_ready() {
+  return !get_ring().overloaded(sendBytes);
+}
+
+inline void admit_awaiter::await_suspend(std::coroutine_handle<> awaiting) {
+  b.set_awaiting(awaiting);
+  get_ring().wait_for_capacity(this);
+}
+
+// Waits until the ring is under its ring_limits, with room for `sendBytes`
+// more to send. Await it before taking on new work, such as the next
+// connection, so a spike queues up outside the process instead of inside it.
+inline admit_awaiter async_admit(size_t sendBytes = 0) {
+  return admit_awaiter(sendBytes);
+}
+
+// The same check without waiting: false means overloaded, so shed the work
+// now, e.g. with a 503, rather than queue it.
+inline bool try_admit(size_t sendBytes = 0) {
+  return !get_ring().overloaded(sendBytes);
+}
+
+// Counts `bytes` against ring_limits::sendBytes for as long as it lives; the
+// socket types hold one across each send.
+struct pending_send {
+  explicit pending_send(size_t bytes)
+  : bytes(bytes)
+  {
+    get_ring().pendingSendBytes += bytes;
+  }
+  pending_send(const pending_send&) = delete;
+  ~pending_send() {
+    get_ring().pendingSendBytes -= bytes;
+  }
+  size_t bytes;
+};
+
+// Asks the kernel to cancel this request. The request still completes (with
+// -ECANCELED if the cancel won), the cancel itself completes without a target.
+inline void syscall_rv_base::cancel() {
+    if (sqe && !done) {
+        io_uring_sqe* s = get_ring().get_sqe();
+        io_uring_prep_cancel(s, this, 0);
+        s->user_data = 0;
+    }
+}
+
+inline syscall_rv<int> async_nop() {
+  io_uring_sqe* s = get_ring().get_sqe();
+  io_uring_prep_nop(s);
+  return s;
+}
+
 inline syscall_rv<ssize_t> async_readv(int fd, const struct iovec *iov, unsigned int iovcnt, off_t offset) {
   io_uring_sqe* s = get_ring().get_sqe();
   io_uring_prep_readv(s, fd, iov, iovcnt, offset);
@@ -157,12 +618,32 @@ inline syscall_rv<ssize_t> async_recvmsg(int sockfd, struct msghdr *msg, int fla
   return s;
 }
 
+// As above, but fails with -ECANCELED if nothing arrives within `timeout`, which
+// must stay valid until the request completes.
+inline syscall_rv<ssize_t> async_recvmsg(int sockfd, struct msghdr *msg, int flags, __kernel_timespec* timeout) {
+  get_ring().reserve(2);
+  io_uring_sqe* s = get_ring().get_sqe();
+  io_uring_prep_recvmsg(s, sockfd, msg, flags);
+  s->flags |= IOSQE_IO_LINK;
+  io_uring_sqe* t = get_ring().get_sqe();
+  io_uring_prep_link_timeout(t, timeout, 0);
+  t->user_data = 0;
+  return s;
+}
+
 inline syscall_rv<int> async_accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen, int flags) {
   io_uring_sqe* s = get_ring().get_sqe();
   io_uring_prep_accept(s, sockfd, addr, addrlen, flags);
   return s;
 }
 
+// Whether a failed accept ran out of descriptors or memory. Retrying at once
+// only spins until something is freed, so accept loops pause first; other
+// failures (an aborted connection, a signal) are retried right away.
+inline bool accept_exhausted(int res) {
+  return res == -EMFILE || res == -ENFILE || res == -ENOBUFS || res == -ENOMEM;
+}
+
 inline syscall_rv<int> async_connect(int sockfd, struct sockaddr* addr, socklen_t addrlen) {
   io_uring_sqe* s = get_ring().get_sqe();
   io_uring_prep_connect(s, sockfd, addr, addrlen);
@@ -223,6 +704,21 @@ inline syscall_rv<int> async_openat2(int dfd, const char *pathname, struct open_
   return s;
 }
 
+// Completes with -ETIME once `ts` has passed, relative to now or, with
+// IORING_TIMEOUT_ABS, as a CLOCK_MONOTONIC time.
+inline syscall_rv<int> async_timeout(__kernel_timespec* ts, unsigned flags = 0) {
+  io_uring_sqe* s = get_ring().get_sqe();
+  io_uring_prep_timeout(s, ts, 0, flags);
+  return s;
+}
+
+// Posts a CQE with res `len` and user_data `data` to another ring (5.18+).
+inline syscall_rv<int> async_msg_ring(int ringFd, unsigned len, uint64_t data) {
+  io_uring_sqe* s = get_ring().get_sqe();
+  io_uring_prep_msg_ring(s, ringFd, len, data, 0);
+  return s;
+}
+
 // io_uring_wait_cqe_timeout(), but applications can also use them specifically for whatever timeout need they have.Applications may delete existing timeouts before they occur with IORING_OP_TIMEOUT_REMOVE. T
 // POLL_ADD
 // POLL_REMOVE
@@ -240,4 +736,25 @@ inline void async_run() {
   get_ring().run();
 }
 
+inline unsigned async_run_once() {
+  return get_ring().run_once();
+}
+
+inline void async_run_for(std::chrono::nanoseconds duration) {
+  get_ring().run_for(duration);
+}
+
+template <typename Awaitable>
+bool async_run_until(Awaitable& f) {
+  return get_ring().run_until(f);
+}
+
+inline int async_event_fd() {
+  return get_ring().event_fd();
+}
+
+inline unsigned async_poll_completions() {
+  return get_ring().poll_completions();
+}
+
 
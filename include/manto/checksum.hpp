@@ -0,0 +1,133 @@
+#pragma once
+
+#include "manto/async_generator.hpp"
+#include "manto/file.hpp"
+#include "manto/future.hpp"
+#include "manto/tcp_socket.hpp"
+#include <cstdint>
+#include <span>
+
+// Continues a CRC32C (Castagnoli) over `data`, using the crc32 and pclmul
+// instructions when the CPU has them. `state` is the raw register; start from
+// ~0u and invert at the end, or use the crc32c struct.
+uint32_t crc32c_update(uint32_t state, std::span<const uint8_t> data);
+
+// The hashes below share one shape: update() with each piece in order, and
+// value() for the hash of everything so far.
+struct crc32c {
+  using value_type = uint32_t;
+  void update(std::span<const uint8_t> data) {
+    state = crc32c_update(state, data);
+  }
+  uint32_t value() const {
+    return ~state;
+  }
+  uint32_t state = ~0u;
+};
+
+// XXH64, for when the checksum only guards against corruption and needs to
+// be fast rather than match an on-disk CRC.
+struct xxhash64 {
+  using value_type = uint64_t;
+  explicit xxhash64(uint64_t seed = 0);
+  void update(std::span<const uint8_t> data);
+  uint64_t value() const;
+private:
+  uint64_t seed;
+  uint64_t acc[4];
+  uint64_t total = 0;
+  uint8_t pending[32];
+  size_t pendingBytes = 0;
+};
+
+// Hashes what is read or written through it, in the order it passes. Each
+// chunk is hashed as soon as the transfer completes, while it is still in
+// cache from the kernel's copy, so checksumming adds no pass over memory of
+// its own. Only the bytes actually transferred are hashed, so short reads
+// and writes keep the hash right.
+template <typename Hash>
+struct checksummed_file {
+  explicit checksummed_file(file& f, Hash hash = Hash())
+  : f(f)
+  , hash(hash)
+  {}
+  future<result<size_t>> read(uint8_t* p, size_t count, ssize_t offset) {
+    result<size_t> rv = co_await f.read(p, count, offset);
+    if (rv) hash.update({ p, *rv });
+    co_return rv;
+  }
+  future<result<size_t>> write(std::span<const uint8_t> msg, ssize_t offset) {
+    result<size_t> rv = co_await f.write(msg, offset);
+    if (rv) hash.update(msg.first(*rv));
+    co_return rv;
+  }
+  // Fills `block` from `offset` and checks it against `expected`, on its own
+  // and apart from the running hash. EBADMSG on a mismatch, ENODATA if the
+  // file ends first.
+  future<result<size_t>> read_block(std::span<uint8_t> block, size_t offset, typename Hash::value_type expected) {
+    Hash h;
+    size_t have = 0;
+    while (have < block.size()) {
+      result<size_t> rv = co_await f.read(block.data() + have, block.size() - have, offset + have);
+      if (!rv) co_return rv;
+      if (*rv == 0) co_return errno_error{ENODATA};
+      h.update(block.subspan(have, *rv));
+      have += *rv;
+    }
+    if (h.value() != expected) co_return errno_error{EBADMSG};
+    co_return have;
+  }
+  file& f;
+  Hash hash;
+};
+
+// The same for a connection.
+template <typename Hash>
+struct checksummed_socket {
+  explicit checksummed_socket(tcp_socket& s, Hash hash = Hash())
+  : s(s)
+  , hash(hash)
+  {}
+  future<result<size_t>> recvmsg(uint8_t* p, size_t count) {
+    result<size_t> rv = co_await s.recvmsg(p, count);
+    if (rv) hash.update({ p, *rv });
+    co_return rv;
+  }
+  future<result<size_t>> sendmsg(std::span<const uint8_t> msg) {
+    result<size_t> rv = co_await s.sendmsg(msg);
+    if (rv) hash.update(msg.first(*rv));
+    co_return rv;
+  }
+  // Receives exactly block.size() bytes and checks them against `expected`.
+  // EBADMSG on a mismatch, ENODATA if the peer closes first.
+  future<result<size_t>> receive_block(std::span<uint8_t> block, typename Hash::value_type expected) {
+    Hash h;
+    size_t have = 0;
+    while (have < block.size()) {
+      result<size_t> rv = co_await s.recvmsg(block.data() + have, block.size() - have);
+      if (!rv) co_return rv;
+      if (*rv == 0) co_return errno_error{ENODATA};
+      h.update(block.subspan(have, *rv));
+      have += *rv;
+    }
+    if (h.value() != expected) co_return errno_error{EBADMSG};
+    co_return have;
+  }
+  tcp_socket& s;
+  Hash hash;
+};
+
+// Passes the chunks of a stream() through unchanged, hashing each on the way.
+// `hash` has to outlive the generator.
+//
+//   crc32c crc;
+//   auto chunks = hashed(f.stream(buffer), crc);
+template <typename Hash>
+async_generator<std::span<const uint8_t>> hashed(async_generator<std::span<const uint8_t>> chunks, Hash& hash) {
+  while (co_await chunks.next()) {
+    std::span<const uint8_t> chunk = chunks.value();
+    hash.update(chunk);
+    co_yield chunk;
+  }
+  if (chunks.error()) co_yield errno_error{chunks.error()};
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Coroutine frames of futures and generators alive on this thread, which
+// ring_limits::frames caps.
+struct coroutine_frames {
+  size_t count = 0;
+  size_t bytes = 0;
+};
+
+inline coroutine_frames& live_frames() {
+  thread_local coroutine_frames frames;
+  return frames;
+}
+
+// Base for promise types whose frames count in live_frames().
+struct counted_frame {
+  static void* operator new(size_t size) {
+    coroutine_frames& f = live_frames();
+    f.count++;
+    f.bytes += size;
+    return ::operator new(size);
+  }
+  static void operator delete(void* p, size_t size) {
+    coroutine_frames& f = live_frames();
+    f.count--;
+    f.bytes -= size;
+    ::operator delete(p, size);
+  }
+};
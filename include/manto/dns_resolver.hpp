@@ -0,0 +1,211 @@
+#pragma once
+
+#include "manto/udp_socket.hpp"
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Stub resolver that asks the configured servers for A and AAAA records over
+// UDP on the calling thread's ring. Answers are cached for their TTL, and
+// concurrent lookups of the same name share one query.
+struct dns_resolver {
+  static constexpr uint16_t type_a = 1, type_aaaa = 28;
+  // Longest query build_query produces: header, 255 byte name, question, OPT record.
+  static constexpr size_t max_query = 12 + 256 + 4 + 11;
+
+  // Reads the nameserver lines of /etc/resolv.conf, falling back to 127.0.0.1.
+  static std::vector<network_address> system_servers();
+  // Encodes a recursive query for `name` with an EDNS0 OPT record, returning
+  // its length, or 0 if the name is not a valid hostname or does not fit.
+  static size_t build_query(uint8_t* buf, size_t size, uint16_t id, std::string_view name, uint16_t qtype);
+  // rcode reported for a truncated (TC) response, whose records are not used.
+  static constexpr int rcode_truncated = -1;
+  // Decodes a response to query `id`. Appends the addresses of all records of
+  // type `qtype` (with `port` filled in), and lowers ttl to the smallest record
+  // TTL seen. Returns false if this is not a well-formed response to that query.
+  static bool parse_response(std::span<const uint8_t> msg, uint16_t id, uint16_t qtype, uint16_t port, std::vector<network_address>& out, uint32_t& ttl, int& rcode);
+
+  dns_resolver(std::vector<network_address> servers = system_servers())
+  : servers(std::move(servers))
+  {}
+
+  std::chrono::milliseconds timeout = std::chrono::seconds(2);
+  int attempts = 2;
+  // How long a name that does not exist (or has no addresses) stays cached.
+  std::chrono::seconds negativeTtl = std::chrono::seconds(5);
+  size_t maxEntries = 4096;
+
+  // Numeric addresses are returned as-is without a query. An empty result means
+  // the name does not exist, has no addresses, or no server answered. Callers
+  // that join a lookup already in flight get the same answer as its starter,
+  // even if it was not cached.
+  future<std::vector<network_address>> resolve(std::string name, uint16_t port = 0) {
+    network_address literal(name);
+    if (literal.valid()) {
+      co_return with_port({literal}, port);
+    }
+    std::string key = normalize(name);
+    if (auto addresses = cached(key))
+      co_return with_port(*addresses, port);
+    auto it = inflight.find(key);
+    if (it != inflight.end()) {
+      std::shared_ptr<pending_lookup> pending = it->second;
+      co_await wait_inflight{pending->waiters};
+      co_return with_port(pending->addresses, port);
+    }
+    std::shared_ptr<pending_lookup> pending = std::make_shared<pending_lookup>();
+    inflight.emplace(key, pending);
+    lookup l = co_await query(key);
+    if (l.answered)
+      store(key, l.addresses, std::chrono::seconds(l.addresses.empty() ? negativeTtl.count() : l.ttl));
+    inflight.erase(key);
+    pending->addresses = l.addresses;
+    for (auto h : std::exchange(pending->waiters, {}))
+      h.resume();
+    co_return with_port(std::move(l.addresses), port);
+  }
+  void clear_cache() {
+    cache.clear();
+  }
+  std::vector<network_address> servers;
+private:
+  struct entry {
+    std::vector<network_address> addresses;
+    std::chrono::steady_clock::time_point expires;
+  };
+  struct lookup {
+    bool answered = false;
+    uint32_t ttl = UINT32_MAX;
+    std::vector<network_address> addresses;
+  };
+  // Shared by everyone waiting on one query; holds the answer for them.
+  struct pending_lookup {
+    std::vector<std::coroutine_handle<>> waiters;
+    std::vector<network_address> addresses;
+  };
+  struct wait_inflight {
+    std::vector<std::coroutine_handle<>>& waiters;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h) { waiters.push_back(h); }
+    void await_resume() {}
+  };
+  static std::string normalize(std::string name) {
+    if (!name.empty() && name.back() == '.') name.pop_back();
+    for (char& c : name) {
+      if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    return name;
+  }
+  static std::vector<network_address> with_port(std::vector<network_address> addresses, uint16_t port) {
+    for (auto& a : addresses) {
+      if (a.sockaddr()->sa_family == AF_INET)
+        reinterpret_cast<sockaddr_in*>(a.sockaddr())->sin_port = htons(port);
+      else if (a.sockaddr()->sa_family == AF_INET6)
+        reinterpret_cast<sockaddr_in6*>(a.sockaddr())->sin6_port = htons(port);
+    }
+    return addresses;
+  }
+  const std::vector<network_address>* cached(const std::string& key) {
+    auto it = cache.find(key);
+    if (it == cache.end()) return nullptr;
+    if (std::chrono::steady_clock::now() >= it->second.expires) {
+      cache.erase(it);
+      return nullptr;
+    }
+    return &it->second.addresses;
+  }
+  void store(const std::string& key, const std::vector<network_address>& addresses, std::chrono::seconds ttl) {
+    if (ttl.count() == 0) return;
+    auto now = std::chrono::steady_clock::now();
+    if (cache.size() >= maxEntries) {
+      std::erase_if(cache, [now](auto& e) { return now >= e.second.expires; });
+      if (cache.size() >= maxEntries)
+        cache.erase(cache.begin());
+    }
+    cache[key] = {addresses, now + ttl};
+  }
+  future<lookup> query(std::string name) {
+    lookup l;
+    uint8_t queries[2][max_query];
+    size_t lengths[2];
+    uint16_t types[2] = { type_a, type_aaaa };
+    uint16_t ids[2];
+    for (size_t n = 0; n < 2; n++) {
+      ids[n] = next_id();
+      lengths[n] = build_query(queries[n], sizeof(queries[n]), ids[n], name, types[n]);
+      if (lengths[n] == 0) {
+        l.answered = true;
+        co_return l;
+      }
+    }
+    for (int attempt = 0; attempt < attempts * (int)servers.size(); attempt++) {
+      const network_address& server = servers[serverOffset % servers.size()];
+      udp_socket sock(0, server.family());
+      if (sock.fd < 0) {
+        serverOffset++;
+        continue;
+      }
+      result<size_t> sentA = co_await sock.sendmsg(server, {queries[0], lengths[0]});
+      result<size_t> sentAAAA = co_await sock.sendmsg(server, {queries[1], lengths[1]});
+      if (!sentA || !sentAAAA) {
+        serverOffset++;
+        continue;
+      }
+      bool done[2] = {};
+      int rcodes[2] = {};
+      std::vector<network_address> found[2];
+      auto deadline = std::chrono::steady_clock::now() + timeout;
+      while (!(done[0] && done[1])) {
+        auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) break;
+        __kernel_timespec ts = { left.count() / 1000000000, left.count() % 1000000000 };
+        uint8_t response[1232];
+        char namebuf[sizeof(struct sockaddr_in6)];
+        struct iovec iov = { response, sizeof(response) };
+        struct msghdr hdr = {};
+        hdr.msg_name = namebuf;
+        hdr.msg_namelen = sizeof(namebuf);
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        ssize_t res = co_await async_recvmsg(sock.fd, &hdr, 0, &ts);
+        if (res == -ECANCELED) break;
+        if (res < 0) continue;
+        if (!(network_address((const struct sockaddr*)namebuf, hdr.msg_namelen) == server)) continue;
+        for (size_t n = 0; n < 2; n++) {
+          if (!done[n] && parse_response({response, (size_t)res}, ids[n], types[n], 0, found[n], l.ttl, rcodes[n])) {
+            done[n] = true;
+            break;
+          }
+        }
+      }
+      // NOERROR and NXDOMAIN are final; anything else (SERVFAIL, REFUSED,
+      // truncation, timeouts) moves on to the next server. There is no TCP
+      // fallback, so a name whose answer never fits in UDP does not resolve.
+      if (done[0] && done[1] && (rcodes[0] == 0 || rcodes[0] == 3) && (rcodes[1] == 0 || rcodes[1] == 3)) {
+        l.answered = true;
+        l.addresses = std::move(found[0]);
+        l.addresses.insert(l.addresses.end(), found[1].begin(), found[1].end());
+        co_return l;
+      }
+      serverOffset++;
+    }
+    co_return l;
+  }
+  uint16_t next_id() {
+    queryId = queryId * 6364136223846793005ULL + 1442695040888963407ULL;
+    return queryId >> 48;
+  }
+  uint64_t queryId = (uint64_t(std::random_device{}()) << 32) | std::random_device{}();
+  size_t serverOffset = 0;
+  std::unordered_map<std::string, entry> cache;
+  std::unordered_map<std::string, std::shared_ptr<pending_lookup>> inflight;
+};
+
+inline dns_resolver& get_resolver() {
+  thread_local dns_resolver resolver;
+  return resolver;
+}
@@ -1,54 +1,8 @@
 #pragma once
 
-#include "source_location.h"
-#include <string>
-
-struct error {
-  error(std::string err = "", source_location loc = source_location())
-  : err(std::move(err))
-  , loc(std::move(loc))
-  {}
-  std::string err;
-  source_location loc;
-};
+// Superseded by result<T>, which carries an errno instead of a heap-allocated
+// message and source location.
+#include "manto/result.hpp"
 
 template <typename T>
-struct expected {
-  bool failed = false;
-  union {
-    error err;
-    T t;
-  };
-  expected(T t = T())
-  : failed(false)
-  , t(t)
-  {}
-  expected(error e)
-  : failed(true)
-  , err(e)
-  {}
-  ~expected() {
-    if (!failed)
-      t.~T();
-    else
-      err.~error();
-  }
-  operator error() {
-    if (!failed) {
-      std::terminate();
-    }
-    return err;
-  }
-  explicit operator bool() {
-    return not failed;
-  }
-  T& value() { 
-    if (failed) {
-      std::terminate();
-    }
-    return t; 
-  }
-  
-};
-
-
+using expected = result<T>;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "manto/async_generator.hpp"
 #include "manto/async_syscall.hpp"
 #include "manto/future.hpp"
 #include <span>
@@ -14,13 +15,20 @@ struct file {
     Overwrite,
   } mode;
   file(int fd = -1, Mode mode = Mode::Readonly);
-  static future<file> create(const std::string& filename, Mode mode = Mode::Readonly);
+  static future<result<file>> create(const std::string& filename, Mode mode = Mode::Readonly);
   file(file&& rhs);
   file& operator=(file&& rhs);
   ~file();
-  future<ssize_t> read(uint8_t* p, size_t count, ssize_t offset);
-  future<ssize_t> write(std::span<const uint8_t> msg, ssize_t offset);
+  // Bytes read (0 at end of file) or written. An offset of -1 uses currentOffset.
+  future<result<size_t>> read(uint8_t* p, size_t count, ssize_t offset);
+  future<result<size_t>> write(std::span<const uint8_t> msg, ssize_t offset);
+  // The file from `offset` to its end, read into `buffer` one chunk at a time.
+  async_generator<std::span<const uint8_t>> stream(std::span<uint8_t> buffer, size_t offset = 0);
+  // Unmapped when destroyed. Empty (p == nullptr) if mmap failed.
   struct mapping {
+    mapping(uint8_t* p, size_t length);
+    mapping(mapping&& rhs);
+    mapping& operator=(mapping&& rhs);
     ~mapping();
     uint8_t* p;
     size_t length;
@@ -32,16 +40,16 @@ struct file {
 };
 
 struct stdio {
-  static future<ssize_t> read(uint8_t* p, size_t count);
-  static future<ssize_t> read(char* p, size_t count);
-  static future<ssize_t> write(std::span<const uint8_t> msg);
-  static future<ssize_t> write(std::string_view msg);
-  static future<ssize_t> write(std::u8string_view msg);
-  static future<ssize_t> write(const char* msg);
-  static future<ssize_t> error(std::span<const uint8_t> msg);
-  static future<ssize_t> error(std::string_view msg);
-  static future<ssize_t> error(std::u8string_view msg);
-  static future<ssize_t> error(const char* msg);
+  static future<result<size_t>> read(uint8_t* p, size_t count);
+  static future<result<size_t>> read(char* p, size_t count);
+  static future<result<size_t>> write(std::span<const uint8_t> msg);
+  static future<result<size_t>> write(std::string_view msg);
+  static future<result<size_t>> write(std::u8string_view msg);
+  static future<result<size_t>> write(const char* msg);
+  static future<result<size_t>> error(std::span<const uint8_t> msg);
+  static future<result<size_t>> error(std::string_view msg);
+  static future<result<size_t>> error(std::u8string_view msg);
+  static future<result<size_t>> error(const char* msg);
 };
 
 
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "manto/file.hpp"
+#include "manto/future.hpp"
+#include "manto/sync.hpp"
+#include <chrono>
+#include <list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+
+// A file's contents as they were when it was loaded. Small files are read into
+// memory, larger ones are mapped. Holders keep it alive after the cache has
+// dropped it, so replacing a file on disk never changes bytes being served;
+// truncating a mapped one in place does, and reading past the new end faults.
+struct cached_file {
+  std::span<const uint8_t> contents() const {
+    if (mapped) return { mapped->p, size };
+    return bytes;
+  }
+  uint64_t size = 0;
+  uint64_t inode = 0;
+  statx_timestamp mtime = {};
+  std::vector<uint8_t> bytes;
+  std::optional<file::mapping> mapped;
+};
+
+// Contents of files that are read over and over, kept for one ring and keyed by
+// path. Holds up to `budget` bytes, dropping the least recently used files
+// first. A hit older than `revalidateAfter` is still served as is, but starts
+// an async_statx in the background, and if the size, mtime or inode changed the
+// entry is dropped so the next get() reloads it. Concurrent misses on one path
+// share a single load.
+//
+// One cache per ring: it is not thread safe, and must outlive the get() calls
+// awaiting a load.
+struct file_cache {
+  explicit file_cache(size_t budget = 64 << 20, std::chrono::steady_clock::duration revalidateAfter = std::chrono::seconds(1), size_t mapThreshold = 256 << 10);
+  file_cache(const file_cache&) = delete;
+  future<result<std::shared_ptr<const cached_file>>> get(std::string path);
+  // A cached entry without loading it; null on a miss.
+  std::shared_ptr<const cached_file> find(const std::string& path);
+  void erase(const std::string& path);
+  void clear();
+  size_t bytes() const {
+    return used;
+  }
+  size_t size() const {
+    return entries.size();
+  }
+private:
+  struct entry {
+    std::shared_ptr<const cached_file> contents;
+    std::list<const std::string*>::iterator lru;
+    std::chrono::steady_clock::time_point checked;
+    bool revalidating = false;
+  };
+  struct pending_load {
+    waiter_queue waiters;
+    std::optional<result<std::shared_ptr<const cached_file>>> outcome;
+  };
+  struct load_waiter : ring_waiter {
+    explicit load_waiter(pending_load& load)
+    : load(load)
+    {}
+    bool await_ready() {
+      return false;
+    }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+      park(awaiting);
+      load.waiters.push(this);
+    }
+    void await_resume() {
+      resumed();
+    }
+    pending_load& load;
+  };
+  future<result<std::shared_ptr<const cached_file>>> load(const std::string& path);
+  future<Void> revalidate(std::string path, std::weak_ptr<int> alive);
+  void insert(const std::string& path, std::shared_ptr<const cached_file> contents);
+  void evict(std::unordered_map<std::string, entry>::iterator it);
+
+  size_t budget, mapThreshold;
+  std::chrono::steady_clock::duration revalidateAfter;
+  size_t used = 0;
+  std::unordered_map<std::string, entry> entries;
+  // Most recently used at the front; points at the keys in `entries`.
+  std::list<const std::string*> lru;
+  std::unordered_map<std::string, std::shared_ptr<pending_load>> loading;
+  // Background revalidations hold a weak_ptr to this, to notice the cache is gone.
+  std::shared_ptr<int> alive = std::make_shared<int>();
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "manto/tcp_socket.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+// How the length ahead of each frame's payload is encoded.
+struct frame_format {
+  unsigned prefixBytes = 4; // 1 to 8, or reads and writes fail with EINVAL
+  bool bigEndian = true;
+  size_t maxFrame = 16 << 20;
+};
+
+// Length-prefixed messages over a tcp_socket. Receives land in a ring buffer
+// that grows to fit the largest frame seen, and read_frame() hands out
+// complete frames where they lie; only a frame that wraps around the end of
+// the ring is copied. Every receive asks for all free space on both sides of
+// the wrap, so small frames arrive many to a syscall.
+struct framed_socket {
+  framed_socket(tcp_socket sock, frame_format format = {}, size_t capacity = 4096)
+  : sock(std::move(sock))
+  , format(format)
+  , ring(std::bit_ceil(std::max<size_t>(capacity, 16)))
+  {}
+  tcp_socket& socket() {
+    return sock;
+  }
+  // The next frame's payload, valid until the next read_frame(). Fails with
+  // ENODATA once the peer closed between frames, EPROTO if it closed mid-frame
+  // and EMSGSIZE for a frame longer than format.maxFrame. Those leave the
+  // stream unusable, so later reads fail the same way.
+  future<result<std::span<const uint8_t>>> read_frame() {
+    head += std::exchange(consumed, 0);
+    if (head == tail) head = tail = 0;
+    if (!valid_prefix()) co_return errno_error{EINVAL};
+    if (error) co_return errno_error{error};
+    for (;;) {
+      size_t available = tail - head;
+      if (available >= format.prefixBytes) {
+        uint64_t length = decode_length();
+        if (length > format.maxFrame) {
+          error = EMSGSIZE;
+          co_return errno_error{error};
+        }
+        size_t frame = format.prefixBytes + length;
+        if (available >= frame) {
+          consumed = frame;
+          co_return payload(head + format.prefixBytes, length);
+        }
+        if (frame > ring.size()) grow(frame);
+      }
+      result<size_t> bytes = co_await receive();
+      if (!bytes) co_return errno_error{bytes.error()};
+      if (*bytes == 0) {
+        error = available ? EPROTO : ENODATA;
+        co_return errno_error{error};
+      }
+      tail += *bytes;
+    }
+  }
+  // Sends the prefix and payload together without copying either. Returns the
+  // payload size once all of it has been sent.
+  future<result<size_t>> write_frame(std::span<const uint8_t> data) {
+    if (!valid_prefix()) co_return errno_error{EINVAL};
+    if (data.size() > format.maxFrame) co_return errno_error{EMSGSIZE};
+    pending_send accounting(data.size());
+    uint8_t prefix[8];
+    encode_length(prefix, data.size());
+    struct iovec iov[2] = { { prefix, format.prefixBytes }, { (void*)data.data(), data.size() } };
+    size_t sent = 0, total = format.prefixBytes + data.size();
+    while (sent < total) {
+      struct msghdr hdr = {};
+      if (sent < format.prefixBytes) {
+        iov[0] = { prefix + sent, format.prefixBytes - sent };
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = 2;
+      } else {
+        iov[1] = { (void*)(data.data() + sent - format.prefixBytes), total - sent };
+        hdr.msg_iov = iov + 1;
+        hdr.msg_iovlen = 1;
+      }
+      int rv = co_await async_sendmsg(sock.fd, &hdr, MSG_NOSIGNAL);
+      if (rv < 0) co_return errno_error{-rv};
+      sent += rv;
+    }
+    co_return data.size();
+  }
+private:
+  bool valid_prefix() const {
+    return format.prefixBytes >= 1 && format.prefixBytes <= 8;
+  }
+  size_t mask() const {
+    return ring.size() - 1;
+  }
+  uint64_t decode_length() const {
+    uint64_t length = 0;
+    for (unsigned n = 0; n < format.prefixBytes; n++) {
+      uint64_t byte = ring[(head + n) & mask()];
+      if (format.bigEndian)
+        length = (length << 8) | byte;
+      else
+        length |= byte << (8 * n);
+    }
+    return length;
+  }
+  void encode_length(uint8_t* prefix, uint64_t length) const {
+    for (unsigned n = 0; n < format.prefixBytes; n++) {
+      unsigned shift = format.bigEndian ? 8 * (format.prefixBytes - 1 - n) : 8 * n;
+      prefix[n] = uint8_t(length >> shift);
+    }
+  }
+  std::span<const uint8_t> payload(size_t pos, size_t length) {
+    size_t start = pos & mask();
+    if (start + length <= ring.size())
+      return { ring.data() + start, length };
+    size_t first = ring.size() - start;
+    wrapped.resize(length);
+    memcpy(wrapped.data(), ring.data() + start, first);
+    memcpy(wrapped.data() + first, ring.data(), length - first);
+    return wrapped;
+  }
+  // Moves the unread bytes to the front of a ring that can hold `frame` bytes.
+  void grow(size_t frame) {
+    std::vector<uint8_t> bigger(std::bit_ceil(frame));
+    size_t available = tail - head, start = head & mask();
+    size_t first = std::min(available, ring.size() - start);
+    memcpy(bigger.data(), ring.data() + start, first);
+    memcpy(bigger.data() + first, ring.data(), available - first);
+    ring = std::move(bigger);
+    head = 0;
+    tail = available;
+  }
+  future<result<size_t>> receive() {
+    size_t space = ring.size() - (tail - head), start = tail & mask();
+    size_t first = std::min(space, ring.size() - start);
+    struct iovec iov[2] = { { ring.data() + start, first }, { ring.data(), space - first } };
+    struct msghdr hdr = {};
+    hdr.msg_iov = iov;
+    hdr.msg_iovlen = space > first ? 2 : 1;
+    co_return syscall_result<size_t>(co_await async_recvmsg(sock.fd, &hdr, 0));
+  }
+
+  tcp_socket sock;
+  frame_format format;
+  std::vector<uint8_t> ring, wrapped;
+  // Offsets into the stream; the ring position is offset & mask().
+  size_t head = 0, tail = 0, consumed = 0;
+  int error = 0;
+};
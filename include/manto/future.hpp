@@ -1,26 +1,40 @@
 #pragma once
 
 #include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
 #include <mutex>
 #include <memory>
+#include <utility>
 #include <variant>
+#include "manto/coroutine_frames.hpp"
+#include "manto/result.hpp"
+#include "manto/trace.hpp"
 
 struct Empty {};
 struct Void {}; // darn it, Matt Calabrese! I need regular void!
+// Where a coroutine gave up, and the errno. Awaiting a future<result<T>> that
+// ended this way yields that errno; other futures cannot report it, so
+// awaiting one of those is fatal.
 struct Error {
-  Error(const char*f, int l) {
-    fprintf(stderr, "FATAL %s %d\n", f, l);
-    abort();
-  }
+  Error(const char* file, int line, int code = EIO)
+  : file(file)
+  , line(line)
+  , code(code)
+  {}
+  const char* file;
+  int line;
+  int code;
 };
 
-#define ERROR() Error(__FILE__, __LINE__)
+#define ERROR(...) Error(__FILE__, __LINE__ __VA_OPT__(,) __VA_ARGS__)
 
 template <typename T> struct future;
 template <typename T> struct promise;
 
 template <typename T>
-struct promise {
+struct promise : counted_frame {
     using handle_type = std::coroutine_handle<promise<T>>;
     std::coroutine_handle<> awaiting = {};
     future<T>* f = nullptr;
@@ -69,6 +83,7 @@ void promise<T>::set_future(future<T>* f) {
 }
 template <typename T>
 auto promise<T>::get_return_object() {
+    trace_record(trace_kind::coroutine_begin, handle_type::from_promise(*this).address());
     return future<T>{handle_type::from_promise(*this)};
 }
 template <typename T>
@@ -77,9 +92,11 @@ auto promise<T>::initial_suspend() {
 }
 template <typename T>
 auto promise<T>::return_value(T v) {
+    trace_record(trace_kind::coroutine_end, handle_type::from_promise(*this).address());
     if (f) {
         f->v = std::move(v);
         if (awaiting) {
+          trace_record(trace_kind::await_end, awaiting.address());
           std::exchange(awaiting, {}).resume();
         }
     }
@@ -87,9 +104,11 @@ auto promise<T>::return_value(T v) {
 }
 template <typename T>
 auto promise<T>::return_value(Error e) {
+    trace_record(trace_kind::coroutine_end, handle_type::from_promise(*this).address());
     if (f) {
         f->v = std::move(e);
         if (awaiting) {
+          trace_record(trace_kind::await_end, awaiting.address());
           std::exchange(awaiting, {}).resume();
         }
     }
@@ -155,6 +174,7 @@ bool future<T>::await_ready() {
 }
 template <typename T>
 void future<T>::await_suspend(std::coroutine_handle<> awaiting) {
+    trace_record(trace_kind::await_begin, awaiting.address(), coro.address());
     coro.promise().awaiting = awaiting;
 }
 template <typename T>
@@ -163,6 +183,14 @@ auto future<T>::await_resume() {
 }
 template <typename T>
 auto future<T>::get_value() {
+    if (const Error* e = std::get_if<Error>(&v)) {
+        if constexpr (is_result<T>::value) {
+            return T(errno_error{e->code});
+        } else {
+            fprintf(stderr, "FATAL %s %d: %s\n", e->file, e->line, strerror(e->code));
+            abort();
+        }
+    }
     return std::move(std::get<T>(v));
 }
 
@@ -1,44 +1,65 @@
 #pragma once
 
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
+
+// The IPv4 parsers behind network_address::from_chars, exposed so the bench
+// can check that they agree. Each returns the end of the address, or nullptr
+// if [first, last) does not start with one; a fifth ".n" part is rejected.
+namespace network_address_detail {
+  const char* parse_dotted_quad_scalar(const char* first, const char* last, uint32_t& ipaddr);
+#if defined(__SSE2__)
+  const char* parse_dotted_quad_sse2(const char* first, const char* last, uint32_t& ipaddr);
+#endif
+}
 
 struct network_address {
   static constexpr size_t buffersize = 32;
-  static void parse_ipv4(sockaddr_in* in, const char* str);
-  static void parse_ipv6(sockaddr_in6* in, const char* str);
-  static void parse_ipv6_noport(sockaddr_in6* in, const char*& str);
-  static void parse_ipv6_wrapped_ipv4(sockaddr_in6* in, const char* str);
+  // Longest text to_chars can produce, "[ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff]:65535".
+  static constexpr size_t max_chars = 47;
+
+  // Parses an IPv4 ("1.2.3.4", "1.2.3.4:80") or IPv6 ("::1", "[::1]:80",
+  // "::ffff:1.2.3.4") address from the start of [first, last), std::from_chars
+  // style: on success ptr points past the address, on failure ptr == first, ec
+  // is set and out is left untouched.
+  static std::from_chars_result from_chars(const char* first, const char* last, network_address& out) noexcept;
+  // Formats into [first, last) without allocating. Fails with value_too_large if
+  // the buffer is too small, or invalid_argument for non-IP addresses.
+  // AF_UNIX addresses format as their path, with abstract names as "@name";
+  // those can be up to sizeof(sockaddr_un) characters.
+  std::to_chars_result to_chars(char* first, char* last) const noexcept;
+  // An AF_UNIX address. A leading '@' names an abstract socket, which has no
+  // file in the filesystem. Left empty if the path does not fit in sun_path.
+  static network_address unix_path(std::string_view path) noexcept;
 
   network_address() noexcept
   : namelen(0)
   {}
-  network_address(const std::string& str) noexcept
+  // Leaves the address empty (namelen 0) if str is not exactly one address.
+  network_address(std::string_view str) noexcept
+  : namelen(0)
   {
-    // TODO: check if this is an OK check to do like this
-    if (str.find("::ffff:") != std::string::npos) {
-      // ipv6-wrapped ipv4 address
-      namelen = sizeof(struct sockaddr_in6);
-      struct sockaddr_in6* a = (struct sockaddr_in6*)sockaddr();
-      parse_ipv6_wrapped_ipv4(a, str.c_str());
-    } else if (str.find(".") != std::string::npos) {
-      namelen = sizeof(struct sockaddr_in);
-      struct sockaddr_in* a = (struct sockaddr_in*)sockaddr();
-      parse_ipv4(a, str.c_str());
-    } else {
-      namelen = sizeof(struct sockaddr_in6);
-      struct sockaddr_in6* a = (struct sockaddr_in6*)sockaddr();
-      parse_ipv6(a, str.c_str());
-    }
+    const char* last = str.data() + str.size();
+    std::from_chars_result r = from_chars(str.data(), last, *this);
+    if (r.ec != std::errc() || r.ptr != last) 
+      resize(0);
   }
   network_address(const struct sockaddr* addr, socklen_t length) noexcept
   : namelen(length)
   {
     if (namelen > buffersize) {
       address.remote = reinterpret_cast<char*>(malloc(namelen));
+      memcpy(address.remote, addr, namelen);
     } else {
       memcpy(address.local, addr, namelen);
     }
@@ -61,14 +82,18 @@ struct network_address {
     }
   }
   void resize(size_t size) {
-    if (size > namelen) {
+    if (size > buffersize) {
       if (namelen > buffersize) {
         address.remote = reinterpret_cast<char*>(realloc(address.remote, size));
       } else {
-        address.remote = reinterpret_cast<char*>(malloc(size));
+        char* p = reinterpret_cast<char*>(malloc(size));
+        memcpy(p, address.local, namelen);
+        address.remote = p;
       }
-    } else if (size <= buffersize) {
-      free(address.remote);
+    } else if (namelen > buffersize) {
+      char* p = address.remote;
+      memcpy(address.local, p, size);
+      free(p);
     }
     namelen = size;
   }
@@ -82,12 +107,13 @@ struct network_address {
     return *this;
   }
   const network_address& operator=(network_address&& rhs) noexcept {
-    if (namelen > buffersize) {
+    if (namelen > buffersize) 
       free(address.remote);
+    namelen = rhs.namelen;
+    if (namelen > buffersize) {
       address.remote = rhs.address.remote;
-      namelen = rhs.namelen;
+      rhs.namelen = 0;
     } else {
-      namelen = rhs.namelen;
       memcpy(address.local, rhs.address.local, namelen);
     }
     return *this;
@@ -120,102 +146,86 @@ struct network_address {
       return address.remote; 
     return address.local; 
   };
-  friend std::string to_string(const network_address& addr) {
-    static char hextab[] = "0123456789abcdef";
-    char buffer[64];
-    size_t pos = 63;
-    buffer[pos] = 0;
-    switch(addr.sockaddr()->sa_family) {
+  bool valid() const noexcept {
+    return namelen != 0;
+  }
+  // AF_INET, AF_INET6 or AF_UNIX, for socket(); AF_UNSPEC if empty.
+  int family() const noexcept {
+    return namelen >= sizeof(sa_family_t) ? sockaddr()->sa_family : AF_UNSPEC;
+  }
+  uint16_t port() const noexcept {
+    if (namelen >= sizeof(sockaddr_in) && sockaddr()->sa_family == AF_INET) 
+      return ntohs(reinterpret_cast<const sockaddr_in*>(buffer())->sin_port);
+    if (namelen >= sizeof(sockaddr_in6) && sockaddr()->sa_family == AF_INET6) 
+      return ntohs(reinterpret_cast<const sockaddr_in6*>(buffer())->sin6_port);
+    return 0;
+  }
+  // Compares family, address and port only; padding such as sin_zero is ignored.
+  friend bool operator==(const network_address& a, const network_address& b) noexcept {
+    if (a.namelen == 0 || b.namelen == 0) 
+      return a.namelen == b.namelen;
+    if (a.sockaddr()->sa_family != b.sockaddr()->sa_family) 
+      return false;
+    switch(a.sockaddr()->sa_family) {
       case AF_INET:
       {
-        struct sockaddr_in* a = (struct sockaddr_in*)addr.sockaddr();
-        uint32_t addr = ntohl(a->sin_addr.s_addr);
-        uint16_t port = ntohs(a->sin_port);
-        if (port) {
-          do {
-            buffer[--pos] = hextab[port % 10];
-            port /= 10;
-          } while (port);
-          buffer[--pos] = ':';
-        }
-        for (size_t n = 0; n < 4; n++) {
-          uint8_t val = (addr >> (n * 8)) & 0xFF;
-          do {
-            buffer[--pos] = hextab[val % 10];
-            val /= 10;
-          } while (val);
-          if (n != 3) buffer[--pos] = '.';
-        }
-        return buffer + pos;
+        auto x = reinterpret_cast<const sockaddr_in*>(a.buffer()), y = reinterpret_cast<const sockaddr_in*>(b.buffer());
+        return x->sin_port == y->sin_port && x->sin_addr.s_addr == y->sin_addr.s_addr;
       }
       case AF_INET6:
       {
-        struct sockaddr_in6* a = (struct sockaddr_in6*)addr.sockaddr();
-        uint16_t port = ntohs(a->sin6_port);
-        if (port) {
-          do {
-            buffer[--pos] = hextab[port % 10];
-            port /= 10;
-          } while (port);
-          buffer[--pos] = ':';
-          buffer[--pos] = ']';
-          port = 1;
-        }
-
-        enum {before, during, after} dc = before;
-        bool is_4in6 = true;
-        for (size_t index = 0; index < 12; index++) {
-          if (index < 10 && a->sin6_addr.s6_addr[index] != 0) is_4in6 = false;
-          else if ((index == 10 || index == 11) && a->sin6_addr.s6_addr[index] != 0xFF) is_4in6 = false;
-        }
-        if (is_4in6) {
-          for (size_t n = 0; n < 4; n++) {
-            uint8_t val = a->sin6_addr.s6_addr[15-n];
-            do {
-              buffer[--pos] = hextab[val % 10];
-              val /= 10;
-            } while (val);
-            if (n != 3) buffer[--pos] = '.';
-          }
-          buffer[--pos] = ':';
-          buffer[--pos] = 'f';
-          buffer[--pos] = 'f';
-          buffer[--pos] = 'f';
-          buffer[--pos] = 'f';
-          buffer[--pos] = ':';
-          buffer[--pos] = ':';
-
-        } else {
-          for (size_t index = 8; index --> 0;) {
-            uint16_t value = (((a->sin6_addr.s6_addr[index*2]) << 8) + (a->sin6_addr.s6_addr[index*2+1]));
-            if (value == 0 && dc == before) {
-              dc = during;
-              buffer[--pos] = ':';
-              if (index == 7) buffer[--pos] = ':';
-            } 
-            if (value != 0 && dc == during) {
-              dc = after;
-            }
-            if (dc == before || dc == after) {
-              do {
-                buffer[--pos] = hextab[value & 0xF];
-                value >>= 4;
-              } while (value);
-              buffer[--pos] = ':';
-            }
-          }
-          if (dc != during)
-            pos++;
-        }
-        if (port) {
-          buffer[--pos] = '[';
-        }
-        return buffer + pos;
+        auto x = reinterpret_cast<const sockaddr_in6*>(a.buffer()), y = reinterpret_cast<const sockaddr_in6*>(b.buffer());
+        return x->sin6_port == y->sin6_port && x->sin6_scope_id == y->sin6_scope_id && memcmp(&x->sin6_addr, &y->sin6_addr, 16) == 0;
       }
       default:
-        return "Unknown sockaddr type";
+        return a.namelen == b.namelen && memcmp(a.buffer(), b.buffer(), a.namelen) == 0;
     }
   }
+  size_t hash() const noexcept {
+    auto mix = [](uint64_t h) {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      return h ^ (h >> 33);
+    };
+    if (namelen == 0) 
+      return 0;
+    switch(sockaddr()->sa_family) {
+      case AF_INET:
+      {
+        auto a = reinterpret_cast<const sockaddr_in*>(buffer());
+        return mix((uint64_t(a->sin_addr.s_addr) << 16) ^ a->sin_port ^ (uint64_t(AF_INET) << 48));
+      }
+      case AF_INET6:
+      {
+        auto a = reinterpret_cast<const sockaddr_in6*>(buffer());
+        uint64_t hi, lo;
+        memcpy(&hi, a->sin6_addr.s6_addr, 8);
+        memcpy(&lo, a->sin6_addr.s6_addr + 8, 8);
+        return mix(mix(hi ^ a->sin6_scope_id) ^ lo ^ (uint64_t(a->sin6_port) << 48));
+      }
+      default:
+      {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t n = 0; n < namelen; n++) 
+          h = (h ^ (uint8_t)buffer()[n]) * 0x100000001b3ULL;
+        return h;
+      }
+    }
+  }
+  friend std::string to_string(const network_address& addr) {
+    char buffer[std::max(max_chars, sizeof(sockaddr_un))];
+    std::to_chars_result r = addr.to_chars(buffer, buffer + sizeof(buffer));
+    if (r.ec != std::errc()) 
+      return "Unknown sockaddr type";
+    return std::string(buffer, r.ptr);
+  }
 };
 
-
+template <>
+struct std::hash<network_address> {
+  size_t operator()(const network_address& addr) const noexcept {
+    return addr.hash();
+  }
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "manto/async_syscall.hpp"
+#include "manto/future.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev deque. The owning thread pushes and pops at the bottom without
+// contention; other threads steal from the top. Fixed capacity, a power of 2.
+template <typename T>
+struct work_stealing_deque {
+  explicit work_stealing_deque(size_t capacity = 256)
+  : slots(capacity)
+  , mask(capacity - 1)
+  {}
+  // Owner only. False when full.
+  bool push(T* item) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t > int64_t(mask)) return false;
+    slots[b & mask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+  // Owner only.
+  T* pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T* item = slots[b & mask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last item; race the thieves for it.
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        item = nullptr;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+  // Any thread. Null when empty or when another thief won.
+  T* steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    T* item = slots[t & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;
+    return item;
+  }
+private:
+  alignas(64) std::atomic<int64_t> top{0};
+  alignas(64) std::atomic<int64_t> bottom{0};
+  std::vector<std::atomic<T*>> slots;
+  size_t mask;
+};
+
+// Work handed to an offload_pool by a coroutine on some ring. When it has run,
+// the worker posts `completion` to that ring with MSG_RING, so the coroutine
+// resumes through the ring's normal completion path and on its own thread.
+struct offload_task {
+  virtual ~offload_task() = default;
+  virtual void run() = 0;
+  // Called on the ring thread; counts as a request in flight on the ring.
+  void prepare(std::coroutine_handle<> awaiting) {
+    kernel_ring& r = get_ring();
+    ringFd = r.ring.ring_fd;
+    r.outstanding_requests++;
+    trace_record(trace_kind::await_begin, awaiting.address(), &completion, 0, IORING_OP_MSG_RING);
+    completion.set_awaiting(awaiting);
+#ifdef MANTO_RING_STATS
+    completion.opcode = IORING_OP_MSG_RING;
+    completion.prepared = ring_stats::now();
+#endif
+  }
+  syscall_rv_base completion;
+  int ringFd = -1;
+  std::exception_ptr error;
+  // The CQE already orders the worker's writes before the resumption; this
+  // says so in terms the C++ memory model (and TSan) can see.
+  std::atomic<bool> ran{false};
+};
+
+// Threads for CPU-heavy steps that would otherwise stall every connection on
+// a ring. Submissions go through a shared queue; a worker takes a batch into
+// its own work_stealing_deque and idle workers steal from the others.
+struct offload_pool {
+  explicit offload_pool(unsigned threads = std::max(1u, std::thread::hardware_concurrency()));
+  // Runs what was already submitted, then joins the workers.
+  ~offload_pool();
+  void submit(offload_task* task);
+private:
+  void work(unsigned index);
+  offload_task* take(work_stealing_deque<offload_task>& local);
+  offload_task* steal(unsigned thief);
+  static void finish(offload_task* task);
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::deque<offload_task*> injected;
+  bool stopping = false;
+  std::vector<std::unique_ptr<work_stealing_deque<offload_task>>> queues;
+  std::vector<std::thread> workers;
+};
+
+// Shared by offload(fn) calls that do not name a pool; one thread per CPU.
+offload_pool& default_offload_pool();
+
+template <typename F>
+struct offload_awaiter : offload_task {
+  using R = std::invoke_result_t<F&>;
+  offload_awaiter(offload_pool& pool, F fn)
+  : pool(pool)
+  , fn(std::move(fn))
+  {}
+  bool await_ready() {
+    return false;
+  }
+  void await_suspend(std::coroutine_handle<> awaiting) {
+    prepare(awaiting);
+    pool.submit(this);
+  }
+  R await_resume() {
+    ran.load(std::memory_order_acquire);
+    if (error) std::rethrow_exception(error);
+    if constexpr (!std::is_void_v<R>) return std::move(*value);
+  }
+  void run() override {
+    try {
+      if constexpr (std::is_void_v<R>)
+        fn();
+      else
+        value.emplace(fn());
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+  offload_pool& pool;
+  F fn;
+  std::optional<std::conditional_t<std::is_void_v<R>, Void, R>> value;
+};
+
+// Runs fn() on a pool thread and resumes the awaiting coroutine on its own
+// ring with the result; exceptions are rethrown there. fn must not touch the
+// ring or anything else owned by the ring thread.
+//
+//   std::vector<uint8_t> packed = co_await offload([&] { return compress(data); });
+template <typename F>
+offload_awaiter<F> offload(F fn) {
+  return { default_offload_pool(), std::move(fn) };
+}
+
+template <typename F>
+offload_awaiter<F> offload(offload_pool& pool, F fn) {
+  return { pool, std::move(fn) };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// The errno a system call failed with.
+struct errno_error {
+  int code;
+  const char* message() const {
+    return strerror(code);
+  }
+};
+
+// A T, or the errno that kept it from being produced. Nothing here allocates,
+// so failing costs the same as succeeding: under load EAGAIN and ECONNRESET
+// are ordinary outcomes that callers branch on, not exceptional ones.
+template <typename T>
+struct [[nodiscard]] result {
+  result(T value)
+  : val(std::move(value))
+  , code(0)
+  {}
+  result(errno_error e)
+  : code(e.code ? e.code : EIO)
+  {}
+  result(const result& rhs)
+  : code(rhs.code)
+  {
+    if (!code) new (&val) T(rhs.val);
+  }
+  result(result&& rhs)
+  : code(rhs.code)
+  {
+    if (!code) new (&val) T(std::move(rhs.val));
+  }
+  result& operator=(const result& rhs) {
+    if (this != &rhs) {
+      this->~result();
+      new (this) result(rhs);
+    }
+    return *this;
+  }
+  result& operator=(result&& rhs) {
+    if (this != &rhs) {
+      this->~result();
+      new (this) result(std::move(rhs));
+    }
+    return *this;
+  }
+  ~result() {
+    if (!code) val.~T();
+  }
+  bool ok() const {
+    return code == 0;
+  }
+  explicit operator bool() const {
+    return ok();
+  }
+  // The errno, or 0 on success.
+  int error() const {
+    return code;
+  }
+  // Only valid when ok().
+  T& value() & { return val; }
+  const T& value() const& { return val; }
+  T&& value() && { return std::move(val); }
+  T& operator*() & { return val; }
+  const T& operator*() const& { return val; }
+  T&& operator*() && { return std::move(val); }
+  T* operator->() { return &val; }
+  const T* operator->() const { return &val; }
+  template <typename U>
+  T value_or(U&& fallback) const& {
+    return ok() ? val : T(std::forward<U>(fallback));
+  }
+private:
+  union {
+    T val;
+  };
+  int code;
+};
+
+template <typename T>
+struct is_result : std::false_type {};
+template <typename T>
+struct is_result<result<T>> : std::true_type {};
+
+// io_uring completions (and liburing) report failure as a negative errno.
+template <typename T, typename R>
+result<T> syscall_result(R rv) {
+  if (rv < 0) return errno_error{int(-rv)};
+  return T(rv);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <linux/io_uring.h>
+
+// Log-linear histogram in the style of HdrHistogram: values are bucketed per
+// power of two with subBuckets linear steps each, so the relative error is at
+// most 1/subBuckets at any magnitude. The default keeps it to a few KB.
+template <unsigned SubBits = 3>
+struct log_histogram {
+  static constexpr unsigned subBits = SubBits, subBuckets = 1 << subBits, magnitudes = 48;
+  std::array<uint64_t, magnitudes * subBuckets> counts = {};
+  uint64_t total = 0, sum = 0, max = 0;
+
+  static unsigned bucket(uint64_t value) {
+    if (value < subBuckets) return value;
+    unsigned shift = 63 - std::countl_zero(value) - subBits;
+    unsigned index = (shift + 1) * subBuckets + ((value >> shift) & (subBuckets - 1));
+    return std::min<unsigned>(index, magnitudes * subBuckets - 1);
+  }
+  static uint64_t lowest(unsigned index) {
+    if (index < subBuckets) return index;
+    unsigned shift = index / subBuckets - 1;
+    return uint64_t(subBuckets + index % subBuckets) << shift;
+  }
+  void record(uint64_t value) {
+    counts[bucket(value)]++;
+    total++;
+    sum += value;
+    max = std::max(max, value);
+  }
+  void merge(const log_histogram& rhs) {
+    for (size_t n = 0; n < counts.size(); n++)
+      counts[n] += rhs.counts[n];
+    total += rhs.total;
+    sum += rhs.sum;
+    max = std::max(max, rhs.max);
+  }
+  // Upper edge of the bucket holding the given percentile (0-100).
+  uint64_t percentile(double p) const {
+    if (total == 0) return 0;
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)(p / 100.0 * total + 0.5));
+    uint64_t seen = 0;
+    for (unsigned n = 0; n < counts.size(); n++) {
+      seen += counts[n];
+      if (seen >= target)
+        return std::min(max, lowest(n + 1) - 1);
+    }
+    return max;
+  }
+  uint64_t mean() const {
+    return total ? sum / total : 0;
+  }
+};
+
+using latency_histogram = log_histogram<>;
+
+// Completion latency per opcode (ns from preparing the SQE to reaping its CQE),
+// in-flight requests per submit, CQEs reaped per wakeup, and how often the SQ
+// was full. Only collected when built with MANTO_RING_STATS.
+struct ring_stats {
+  std::array<std::unique_ptr<latency_histogram>, IORING_OP_LAST> latency;
+  latency_histogram queueDepth;
+  latency_histogram cqeBatch;
+  uint64_t sqFull = 0;
+  uint64_t submits = 0;
+
+  ring_stats() = default;
+  ring_stats(ring_stats&&) = default;
+  ring_stats& operator=(ring_stats&&) = default;
+  ring_stats(const ring_stats& rhs)
+  : queueDepth(rhs.queueDepth)
+  , cqeBatch(rhs.cqeBatch)
+  , sqFull(rhs.sqFull)
+  , submits(rhs.submits)
+  {
+    for (size_t n = 0; n < latency.size(); n++) {
+      if (rhs.latency[n])
+        latency[n] = std::make_unique<latency_histogram>(*rhs.latency[n]);
+    }
+  }
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  void record_completion(uint8_t opcode, uint64_t nanoseconds) {
+    if (opcode >= latency.size()) return;
+    if (!latency[opcode])
+      latency[opcode] = std::make_unique<latency_histogram>();
+    latency[opcode]->record(nanoseconds);
+  }
+  // Latency of one opcode, or an empty histogram if it was never used.
+  latency_histogram for_opcode(uint8_t opcode) const {
+    return opcode < latency.size() && latency[opcode] ? *latency[opcode] : latency_histogram{};
+  }
+};
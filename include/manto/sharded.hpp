@@ -0,0 +1,149 @@
+#pragma once
+
+#include "manto/tcp_socket.hpp"
+#include "manto/udp_socket.hpp"
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Makes the SO_REUSEPORT group that `fd` belongs to pick the socket whose index
+// matches the CPU the packet arrived on, modulo the group size. Sockets get
+// their index in the order they joined the group.
+inline bool attach_cpu_steering(int fd, size_t shards) {
+  struct sock_filter code[] = {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+    { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)shards },
+    { BPF_RET | BPF_A, 0, 0, 0 },
+  };
+  struct sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+  return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
+
+// One thread per shard, each driving its own ring from body(). With pinning, shard n runs
+// on CPU n so that it lines up with attach_cpu_steering.
+struct shard_threads {
+  void start(size_t shards, bool pin, std::function<void(size_t)> body) {
+    for (size_t n = 0; n < shards; n++) {
+      threads.emplace_back([n, pin, body] {
+        if (pin) {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET(n, &set);
+          pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        body(n);
+      });
+    }
+  }
+  void join() {
+    for (auto& t : threads) 
+      t.join();
+    threads.clear();
+  }
+  std::vector<std::thread> threads;
+};
+
+// Accepts on `shards` SO_REUSEPORT sockets bound to the same address, each on
+// its own thread and ring. Connections are handed to onConnect on the thread
+// that accepted them and stay there. If any socket cannot be set up (or shards
+// is 0) none are kept, no threads start, and error() says why.
+struct sharded_tcp_listener {
+  sharded_tcp_listener(network_address listen_address, size_t shards, std::function<void(tcp_socket)> onConnect, bool steerByCpu = false) {
+    if (shards == 0) {
+      setupError = EINVAL;
+      return;
+    }
+    // All sockets join the group here, in order, so that their group index
+    // matches their shard number.
+    for (size_t n = 0; n < shards; n++) {
+      int fd = tcp_listen_socket::listen_fd(listen_address, true, SOMAXCONN);
+      if (fd < 0) {
+        setupError = errno;
+        for (int open : fds) 
+          close(open);
+        fds.clear();
+        return;
+      }
+      fds.push_back(fd);
+    }
+    if (steerByCpu) 
+      cpuSteering = attach_cpu_steering(fds[0], shards);
+    threads.start(shards, steerByCpu, [this, onConnect](size_t n) {
+      tcp_listen_socket listener(fds[n], onConnect);
+      async_run();
+    });
+  }
+  ~sharded_tcp_listener() {
+    // Wakes the accept loops; each thread returns once its connections are done.
+    for (int fd : fds) 
+      shutdown(fd, SHUT_RDWR);
+    threads.join();
+  }
+  // Whether steerByCpu took effect. If the kernel refused the filter, the
+  // group spreads connections by hash, so they no longer stay on the CPU
+  // that received them.
+  bool steered() const {
+    return cpuSteering;
+  }
+  // The errno that kept the listener from starting, or 0.
+  int error() const {
+    return setupError;
+  }
+  std::vector<int> fds;
+  shard_threads threads;
+  bool cpuSteering = false;
+  int setupError = 0;
+};
+
+// UDP counterpart: one SO_REUSEPORT socket per thread, each passed to serve() on
+// its own thread. serve() should return once stopping() is set; the destructor
+// sets it and shuts the sockets down for reading to wake pending receives.
+// Setup failures are reported like sharded_tcp_listener's.
+struct sharded_udp_socket {
+  sharded_udp_socket(network_address bindAddress, size_t shards, std::function<future<Void>(udp_socket&)> serve, bool steerByCpu = false) {
+    if (shards == 0) {
+      setupError = EINVAL;
+      return;
+    }
+    sockets.reserve(shards);
+    for (size_t n = 0; n < shards; n++) {
+      sockets.emplace_back(bindAddress, true);
+      if (sockets.back().fd < 0) {
+        setupError = errno;
+        sockets.clear();
+        return;
+      }
+    }
+    if (steerByCpu) 
+      cpuSteering = attach_cpu_steering(sockets[0].fd, shards);
+    threads.start(shards, steerByCpu, [this, serve](size_t n) {
+      auto f = serve(sockets[n]);
+      async_run();
+    });
+  }
+  ~sharded_udp_socket() {
+    stop = true;
+    for (auto& s : sockets) 
+      shutdown(s.fd, SHUT_RD);
+    threads.join();
+  }
+  bool stopping() const {
+    return stop;
+  }
+  // As for sharded_tcp_listener.
+  bool steered() const {
+    return cpuSteering;
+  }
+  int error() const {
+    return setupError;
+  }
+  std::atomic<bool> stop{false};
+  std::vector<udp_socket> sockets;
+  shard_threads threads;
+  bool cpuSteering = false;
+  int setupError = 0;
+};
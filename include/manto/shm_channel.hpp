@@ -0,0 +1,155 @@
+#pragma once
+
+#include "manto/async_syscall.hpp"
+#include "manto/file.hpp"
+#include "manto/future.hpp"
+#include <array>
+#include <atomic>
+#include <optional>
+#include <span>
+#include <unistd.h>
+
+// Lives at the start of the shared region, followed by `capacity` slots of
+// `stride` bytes. Positions only increase; the slot is position & (capacity-1).
+struct shm_channel_header {
+  uint32_t magic;
+  uint32_t capacity;
+  uint32_t slotSize;
+  uint32_t stride;
+  bool multipleProducers;
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint32_t> consumerParked;
+  alignas(64) std::atomic<uint32_t> producersWaiting;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock-free");
+
+// A bounded message queue in shared memory between processes, for one consumer
+// and one or many producers. Each slot carries a sequence number that says
+// whose turn it is, so while both sides keep up a message costs two memcpys
+// and no syscalls. Only a consumer that finds the queue empty parks, on a
+// read of an eventfd submitted to its ring, and the producer that publishes
+// next writes the eventfd; producers facing a full queue park the same way on
+// a second eventfd.
+//
+// One process creates the channel and passes handles() to the other, e.g.
+// with unix_stream_socket::sendmsg; that one calls open().
+struct shm_channel {
+  static result<shm_channel> create(uint32_t capacity, uint32_t slotSize, bool multipleProducers = false);
+  // Takes ownership of the descriptors.
+  static result<shm_channel> open(std::array<int, 3> handles);
+  shm_channel(shm_channel&& rhs);
+  shm_channel& operator=(shm_channel&& rhs);
+  ~shm_channel();
+  // The memfd and the two eventfds.
+  std::array<int, 3> handles() const {
+    return { memory.fd, wakeFd, spaceFd };
+  }
+  size_t max_message() const {
+    return header->slotSize;
+  }
+
+  // False if the queue is full or msg is longer than max_message().
+  bool try_send(std::span<const uint8_t> msg) {
+    if (msg.size() > header->slotSize) return false;
+    uint64_t pos = header->tail.load(std::memory_order_relaxed);
+    uint8_t* s;
+    for (;;) {
+      s = slot(pos);
+      int64_t diff = int64_t(sequence(s).load(std::memory_order_acquire) - pos);
+      if (diff < 0) return false;
+      if (diff > 0) {
+        pos = header->tail.load(std::memory_order_relaxed);
+      } else if (!header->multipleProducers) {
+        header->tail.store(pos + 1, std::memory_order_relaxed);
+        break;
+      } else if (header->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    uint32_t length = msg.size();
+    memcpy(s + sizeof(uint64_t), &length, sizeof(length));
+    memcpy(s + slot_data, msg.data(), msg.size());
+    sequence(s).store(pos + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->consumerParked.load(std::memory_order_relaxed) && header->consumerParked.exchange(0))
+      notify(wakeFd);
+    return true;
+  }
+  // Waits for space while the queue is full. Fails with EMSGSIZE if msg is
+  // longer than max_message().
+  future<result<size_t>> send(std::span<const uint8_t> msg) {
+    if (msg.size() > header->slotSize) co_return errno_error{EMSGSIZE};
+    for (;;) {
+      if (try_send(msg)) co_return msg.size();
+      header->producersWaiting.fetch_add(1);
+      if (try_send(msg)) {
+        header->producersWaiting.fetch_sub(1);
+        co_return msg.size();
+      }
+      uint64_t count;
+      int rv = co_await async_read(spaceFd, &count, sizeof(count), 0);
+      header->producersWaiting.fetch_sub(1);
+      if (rv < 0) co_return errno_error{-rv};
+    }
+  }
+
+  // The next message without waiting. Like receive(), it stays valid until the
+  // next try_receive() or receive(), and only one thread may consume.
+  std::optional<std::span<const uint8_t>> try_receive() {
+    release();
+    uint64_t pos = header->head.load(std::memory_order_relaxed);
+    uint8_t* s = slot(pos);
+    if (sequence(s).load(std::memory_order_acquire) != pos + 1) return std::nullopt;
+    uint32_t length;
+    memcpy(&length, s + sizeof(uint64_t), sizeof(length));
+    holding = true;
+    return std::span<const uint8_t>(s + slot_data, std::min(length, header->slotSize));
+  }
+  future<result<std::span<const uint8_t>>> receive() {
+    for (;;) {
+      if (auto msg = try_receive()) co_return *msg;
+      header->consumerParked.store(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (auto msg = try_receive()) {
+        header->consumerParked.store(0, std::memory_order_relaxed);
+        co_return *msg;
+      }
+      uint64_t count;
+      int rv = co_await async_read(wakeFd, &count, sizeof(count), 0);
+      header->consumerParked.store(0, std::memory_order_relaxed);
+      if (rv < 0) co_return errno_error{-rv};
+    }
+  }
+private:
+  static constexpr size_t slot_data = 16;
+  shm_channel(file memory, file::mapping region, int wakeFd, int spaceFd);
+  uint8_t* slot(uint64_t pos) const {
+    return slots + (pos & (header->capacity - 1)) * header->stride;
+  }
+  static std::atomic<uint64_t>& sequence(uint8_t* slot) {
+    return *reinterpret_cast<std::atomic<uint64_t>*>(slot);
+  }
+  static void notify(int fd) {
+    uint64_t one = 1;
+    (void)!::write(fd, &one, sizeof(one));
+  }
+  // Hands the slot of the last message back to the producers.
+  void release() {
+    if (!holding) return;
+    holding = false;
+    uint64_t pos = header->head.load(std::memory_order_relaxed);
+    sequence(slot(pos)).store(pos + header->capacity, std::memory_order_release);
+    header->head.store(pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->producersWaiting.load(std::memory_order_relaxed))
+      notify(spaceFd);
+  }
+
+  file memory;
+  file::mapping region;
+  shm_channel_header* header;
+  uint8_t* slots;
+  int wakeFd, spaceFd;
+  bool holding = false;
+};
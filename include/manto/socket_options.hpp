@@ -0,0 +1,51 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Options to set on a socket before it connects, binds or listens. Zero or
+// false leaves the kernel default. Accepted connections inherit most of them
+// from the listening socket; TCP_QUICKACK is the exception.
+struct socket_options {
+  // TCP_NODELAY: send small writes at once instead of holding them back to
+  // coalesce (Nagle).
+  bool noDelay = false;
+  // TCP_QUICKACK: acknowledge at once instead of delaying. The kernel goes
+  // back to delayed acks by itself, so this has to be set again to last.
+  bool quickAck = false;
+  // SO_RCVBUF and SO_SNDBUF in bytes. Setting one turns off the kernel's
+  // autotuning for that direction.
+  int receiveBuffer = 0;
+  int sendBuffer = 0;
+  // SO_BUSY_POLL: microseconds a receive may spin on the device queue before
+  // sleeping, trading CPU for latency.
+  int busyPoll = 0;
+  bool reusePort = false;
+  // Listening sockets. TCP_DEFER_ACCEPT: seconds to hold a connection back
+  // until its first data arrives, so accept never hands over an idle one.
+  int deferAccept = 0;
+  // Listening sockets. TCP_FASTOPEN: how many connections to accept data in
+  // their SYN from at once. Needs bit 2 of the net.ipv4.tcp_fastopen sysctl.
+  int fastOpenQueue = 0;
+  // Connecting sockets. TCP_FASTOPEN_CONNECT: once the server has handed out
+  // a cookie, connect completes at once and the first send goes in the SYN,
+  // saving a round trip. Needs bit 1 of net.ipv4.tcp_fastopen (the default).
+  bool fastOpenConnect = false;
+
+  // False with errno set if any of them could not be set.
+  bool apply(int fd) const {
+    auto set = [fd](int level, int name, int value) {
+      return setsockopt(fd, level, name, &value, sizeof(value)) == 0;
+    };
+    return (!noDelay || set(IPPROTO_TCP, TCP_NODELAY, 1))
+        && (!quickAck || set(IPPROTO_TCP, TCP_QUICKACK, 1))
+        && (!receiveBuffer || set(SOL_SOCKET, SO_RCVBUF, receiveBuffer))
+        && (!sendBuffer || set(SOL_SOCKET, SO_SNDBUF, sendBuffer))
+        && (!busyPoll || set(SOL_SOCKET, SO_BUSY_POLL, busyPoll))
+        && (!reusePort || set(SOL_SOCKET, SO_REUSEPORT, 1))
+        && (!deferAccept || set(IPPROTO_TCP, TCP_DEFER_ACCEPT, deferAccept))
+        && (!fastOpenQueue || set(IPPROTO_TCP, TCP_FASTOPEN, fastOpenQueue))
+        && (!fastOpenConnect || set(IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1));
+  }
+};
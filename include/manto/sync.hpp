@@ -0,0 +1,335 @@
+#pragma once
+
+#include "manto/async_syscall.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Posts `data` to another thread's ring with MSG_RING and waits for the result,
+// 0 or -errno. It goes through a small ring of the calling thread's own rather
+// than get_ring(), so no completion is left behind on a ring the thread may
+// not be running, and a failed post is seen instead of lost.
+inline int post_wakeup(int ringFd, uint64_t data) {
+  struct wake_ring {
+    wake_ring() {
+      if (io_uring_queue_init(4, &ring, 0) < 0) throw 42;
+    }
+    ~wake_ring() {
+      io_uring_queue_exit(&ring);
+    }
+    struct io_uring ring;
+  };
+  thread_local wake_ring w;
+  io_uring_sqe* s = io_uring_get_sqe(&w.ring);
+  io_uring_prep_msg_ring(s, ringFd, 0, data, 0);
+  int rv;
+  while ((rv = io_uring_submit_and_wait(&w.ring, 1)) == -EINTR) {}
+  if (rv < 0) return rv;
+  io_uring_cqe* cqe;
+  while ((rv = io_uring_wait_cqe(&w.ring, &cqe)) == -EINTR) {}
+  if (rv < 0) return rv;
+  rv = cqe->res;
+  io_uring_cqe_seen(&w.ring, cqe);
+  return rv;
+}
+
+// A coroutine suspended on a synchronization primitive, and the ring it has
+// to resume on. Waking from that ring's own thread resumes it right away;
+// from any other thread the wakeup is posted to its ring with MSG_RING, so a
+// coroutine only ever runs on its own thread. A parked coroutine counts as a
+// request in flight, so run() keeps going until it is woken.
+struct ring_waiter {
+  ring_waiter() = default;
+  ring_waiter(const ring_waiter&) = delete;
+  void park(std::coroutine_handle<> awaiting) {
+    ring = &get_ring();
+    ringFd = ring->ring.ring_fd;
+    ring->outstanding_requests++;
+    trace_record(trace_kind::await_begin, awaiting.address(), &completion, 0, IORING_OP_MSG_RING);
+    completion.set_awaiting(awaiting);
+#ifdef MANTO_RING_STATS
+    completion.opcode = IORING_OP_MSG_RING;
+    completion.prepared = ring_stats::now();
+#endif
+  }
+  // The waiter may be gone by the time this returns.
+  void wake() {
+    kernel_ring& current = get_ring();
+    if (&current == ring) {
+      ring->outstanding_requests--;
+      completion.signal(0);
+      return;
+    }
+    int fd = ringFd;
+    uintptr_t data = (uintptr_t)&completion;
+    woken.store(true, std::memory_order_release);
+    int rv = post_wakeup(fd, data);
+    if (rv < 0) {
+      fprintf(stderr, "FATAL sync: cannot wake a waiter on ring %d: %s\n", fd, strerror(-rv));
+      abort();
+    }
+  }
+  // Call first thing after resuming. The CQE already orders the waker's writes
+  // before it; this says so in terms the C++ memory model (and TSan) can see.
+  void resumed() {
+    woken.load(std::memory_order_acquire);
+  }
+  syscall_rv_base completion;
+  kernel_ring* ring = nullptr;
+  int ringFd = -1;
+  ring_waiter* next = nullptr;
+  std::atomic<bool> woken{false};
+};
+
+// FIFO of waiters, linked through the waiters themselves.
+struct waiter_queue {
+  waiter_queue() = default;
+  waiter_queue(const waiter_queue&) = delete;
+  bool empty() const {
+    return !head;
+  }
+  void push(ring_waiter* w) {
+    w->next = nullptr;
+    *tail = w;
+    tail = &w->next;
+  }
+  ring_waiter* pop() {
+    ring_waiter* w = head;
+    head = w->next;
+    if (!head) tail = &head;
+    return w;
+  }
+  // Call without holding the primitive's lock; each waiter is gone once woken.
+  void wake_all() {
+    while (!empty())
+      pop()->wake();
+  }
+  ring_waiter* head = nullptr;
+  ring_waiter** tail = &head;
+};
+
+// Counting semaphore for coroutines on any number of rings. The internal lock
+// only guards the count and the queue, never a suspension. Waiters are served
+// in order, and a release hands its unit straight to the first waiter so
+// later arrivals cannot barge in ahead of it.
+struct async_semaphore {
+  explicit async_semaphore(size_t count = 0)
+  : count(count)
+  {}
+  async_semaphore(const async_semaphore&) = delete;
+  struct acquire_awaiter : ring_waiter {
+    explicit acquire_awaiter(async_semaphore& s)
+    : s(s)
+    {}
+    bool await_ready() {
+      return s.try_acquire();
+    }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+      std::lock_guard<std::mutex> l(s.lock);
+      if (s.count) {
+        s.count--;
+        return false;
+      }
+      park(awaiting);
+      s.waiters.push(this);
+      return true;
+    }
+    void await_resume() {
+      resumed();
+    }
+    async_semaphore& s;
+  };
+  acquire_awaiter acquire() {
+    return acquire_awaiter(*this);
+  }
+  bool try_acquire() {
+    std::lock_guard<std::mutex> l(lock);
+    if (!count) return false;
+    count--;
+    return true;
+  }
+  void release(size_t n = 1) {
+    waiter_queue woken;
+    {
+      std::lock_guard<std::mutex> l(lock);
+      for (; n && !waiters.empty(); n--)
+        woken.push(waiters.pop());
+      count += n;
+    }
+    woken.wake_all();
+  }
+private:
+  std::mutex lock;
+  size_t count;
+  waiter_queue waiters;
+};
+
+struct async_mutex;
+
+// Unlocks on destruction, like std::lock_guard.
+struct async_lock_guard {
+  explicit async_lock_guard(async_mutex& m)
+  : m(&m)
+  {}
+  async_lock_guard(async_lock_guard&& rhs)
+  : m(std::exchange(rhs.m, nullptr))
+  {}
+  async_lock_guard& operator=(async_lock_guard&&) = delete;
+  ~async_lock_guard();
+private:
+  async_mutex* m;
+};
+
+// Holding it across a co_await is fine; other coroutines wanting it suspend
+// instead of blocking their thread.
+//
+//   async_lock_guard guard = co_await m.scoped_lock();
+struct async_mutex {
+  struct scoped_awaiter : async_semaphore::acquire_awaiter {
+    explicit scoped_awaiter(async_mutex& m)
+    : acquire_awaiter(m.sem)
+    , m(m)
+    {}
+    async_lock_guard await_resume() {
+      resumed();
+      return async_lock_guard(m);
+    }
+    async_mutex& m;
+  };
+  async_semaphore::acquire_awaiter lock() {
+    return sem.acquire();
+  }
+  scoped_awaiter scoped_lock() {
+    return scoped_awaiter(*this);
+  }
+  bool try_lock() {
+    return sem.try_acquire();
+  }
+  void unlock() {
+    sem.release();
+  }
+private:
+  async_semaphore sem{1};
+};
+
+inline async_lock_guard::~async_lock_guard() {
+  if (m) m->unlock();
+}
+
+// Bounded queue between coroutines on any rings. send() waits while the
+// channel is full and receive() while it is empty; with capacity 0 every
+// send waits for a receiver. Values go straight to a waiting receiver without
+// passing through the buffer. After close(), send() fails and receive()
+// drains what is left and then returns nullopt.
+template <typename T>
+struct channel {
+  explicit channel(size_t capacity)
+  : capacity(capacity)
+  {}
+  channel(const channel&) = delete;
+
+  struct send_awaiter : ring_waiter {
+    send_awaiter(channel& c, T value)
+    : c(c)
+    , value(std::move(value))
+    {}
+    bool await_ready() {
+      return false;
+    }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+      ring_waiter* receiver = nullptr;
+      {
+        std::lock_guard<std::mutex> l(c.lock);
+        if (c.closed) return false;
+        if (!c.receivers.empty()) {
+          receive_awaiter* r = static_cast<receive_awaiter*>(c.receivers.pop());
+          r->value.emplace(std::move(value));
+          receiver = r;
+        } else if (c.buffer.size() < c.capacity) {
+          c.buffer.push_back(std::move(value));
+        } else {
+          park(awaiting);
+          c.senders.push(this);
+          return true;
+        }
+        sent = true;
+      }
+      if (receiver) receiver->wake();
+      return false;
+    }
+    // False if the channel was closed before the value got in.
+    bool await_resume() {
+      resumed();
+      return sent;
+    }
+    channel& c;
+    T value;
+    bool sent = false;
+  };
+
+  struct receive_awaiter : ring_waiter {
+    explicit receive_awaiter(channel& c)
+    : c(c)
+    {}
+    bool await_ready() {
+      return false;
+    }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+      ring_waiter* sender = nullptr;
+      {
+        std::lock_guard<std::mutex> l(c.lock);
+        send_awaiter* s = c.senders.empty() ? nullptr : static_cast<send_awaiter*>(c.senders.pop());
+        if (!c.buffer.empty()) {
+          value.emplace(std::move(c.buffer.front()));
+          c.buffer.pop_front();
+          if (s) c.buffer.push_back(std::move(s->value));
+        } else if (s) {
+          value.emplace(std::move(s->value));
+        } else if (!c.closed) {
+          park(awaiting);
+          c.receivers.push(this);
+          return true;
+        }
+        if (s) s->sent = true;
+        sender = s;
+      }
+      if (sender) sender->wake();
+      return false;
+    }
+    std::optional<T> await_resume() {
+      resumed();
+      return std::move(value);
+    }
+    channel& c;
+    std::optional<T> value;
+  };
+
+  send_awaiter send(T value) {
+    return send_awaiter(*this, std::move(value));
+  }
+  receive_awaiter receive() {
+    return receive_awaiter(*this);
+  }
+  void close() {
+    waiter_queue woken;
+    {
+      std::lock_guard<std::mutex> l(lock);
+      closed = true;
+      while (!senders.empty()) woken.push(senders.pop());
+      while (!receivers.empty()) woken.push(receivers.pop());
+    }
+    woken.wake_all();
+  }
+private:
+  std::mutex lock;
+  size_t capacity;
+  std::deque<T> buffer;
+  waiter_queue senders, receivers;
+  bool closed = false;
+};
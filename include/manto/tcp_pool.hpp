@@ -0,0 +1,127 @@
+#pragma once
+
+#include "manto/tcp_socket.hpp"
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+struct tcp_pool;
+
+// A connection checked out of a tcp_pool. It goes back to the pool when the
+// handle is released, unless discard() was called, e.g. after a protocol error
+// that leaves the connection in an unknown state.
+struct pooled_tcp_socket {
+  pooled_tcp_socket() = default;
+  pooled_tcp_socket(tcp_pool* pool, tcp_socket sock) 
+  : pool(pool)
+  , sock(std::move(sock))
+  {}
+  pooled_tcp_socket(pooled_tcp_socket&& rhs) 
+  : pool(std::exchange(rhs.pool, nullptr))
+  , sock(std::move(rhs.sock))
+  {}
+  pooled_tcp_socket& operator=(pooled_tcp_socket&& rhs) {
+    if (this == &rhs) return *this;
+    release();
+    pool = std::exchange(rhs.pool, nullptr);
+    sock = std::move(rhs.sock);
+    return *this;
+  }
+  ~pooled_tcp_socket() {
+    release();
+  }
+  tcp_socket& operator*() { return sock; }
+  tcp_socket* operator->() { return &sock; }
+  void discard() {
+    pool = nullptr;
+  }
+  void release();
+private:
+  tcp_pool* pool = nullptr;
+  tcp_socket sock;
+};
+
+// Keeps idle connections per target so repeated requests to the same backend
+// skip the handshake. One pool per ring; handles must be released on the thread
+// that checked them out. Every connect() and release() also closes connections
+// of any target that have been idle past idleTimeout, at most a quarter of
+// idleTimeout apart, so a target that is never used again does not keep them.
+struct tcp_pool {
+  size_t maxIdle = 8;
+  std::chrono::steady_clock::duration idleTimeout = std::chrono::seconds(30);
+
+  future<result<pooled_tcp_socket>> connect(network_address target) {
+    auto now = std::chrono::steady_clock::now();
+    sweep(now);
+    auto it = idle.find(target);
+    if (it != idle.end()) {
+      auto& list = it->second;
+      while (!list.empty()) {
+        idle_connection c = std::move(list.back());
+        list.pop_back();
+        if (now - c.since < idleTimeout && healthy(c.sock)) {
+          if (list.empty()) idle.erase(it);
+          co_return pooled_tcp_socket(this, std::move(c.sock));
+        }
+      }
+      idle.erase(it);
+    }
+    result<tcp_socket> sock = co_await tcp_socket::create(target);
+    if (!sock) co_return errno_error{sock.error()};
+    co_return pooled_tcp_socket(this, std::move(*sock));
+  }
+  void release(tcp_socket sock) {
+    if (sock.fd == -1) return;
+    auto now = std::chrono::steady_clock::now();
+    sweep(now);
+    auto& list = idle[sock.target];
+    drop_expired(list, now);
+    if (list.size() >= maxIdle) return;
+    list.push_back({std::move(sock), now});
+  }
+  size_t idle_count(const network_address& target) const {
+    auto it = idle.find(target);
+    return it == idle.end() ? 0 : it->second.size();
+  }
+private:
+  struct idle_connection {
+    tcp_socket sock;
+    std::chrono::steady_clock::time_point since;
+  };
+  // An idle connection should have nothing to read. EOF means the peer closed
+  // it, and stray data means we no longer know where the protocol stands.
+  static bool healthy(const tcp_socket& s) {
+    char c;
+    return recv(s.fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+  // Each list is oldest first.
+  void drop_expired(std::vector<idle_connection>& list, std::chrono::steady_clock::time_point now) {
+    size_t expired = 0;
+    while (expired < list.size() && now - list[expired].since >= idleTimeout) 
+      expired++;
+    list.erase(list.begin(), list.begin() + expired);
+  }
+  void sweep(std::chrono::steady_clock::time_point now) {
+    if (now - lastSweep < idleTimeout / 4) return;
+    lastSweep = now;
+    for (auto it = idle.begin(); it != idle.end();) {
+      drop_expired(it->second, now);
+      if (it->second.empty()) 
+        it = idle.erase(it);
+      else 
+        ++it;
+    }
+  }
+  std::unordered_map<network_address, std::vector<idle_connection>> idle;
+  std::chrono::steady_clock::time_point lastSweep;
+};
+
+inline void pooled_tcp_socket::release() {
+  if (pool) 
+    std::exchange(pool, nullptr)->release(std::move(sock));
+}
+
+inline tcp_pool& get_tcp_pool() {
+  thread_local tcp_pool pool;
+  return pool;
+}
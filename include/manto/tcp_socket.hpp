@@ -1,8 +1,12 @@
 #pragma once
 
+#include "manto/async_generator.hpp"
 #include "manto/async_syscall.hpp"
 #include "manto/future.hpp"
 #include "manto/network_address.hpp"
+#include "manto/socket_options.hpp"
+#include <atomic>
+#include <functional>
 #include <span>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -12,6 +16,8 @@
 
 struct tcp_socket {
   friend struct tcp_listen_socket;
+  friend struct framed_socket;
+  friend struct tcp_pool;
   tcp_socket()
   : fd(-1)
   {}
@@ -20,10 +26,20 @@ struct tcp_socket {
   , fd(fd)
   {
   }
-  static future<tcp_socket> create(network_address target)
+  static future<result<tcp_socket>> create(network_address target, socket_options options = {})
   {
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    co_await async_connect(fd, target.sockaddr(), target.length());
+    int fd = socket(target.family(), SOCK_STREAM, 0);
+    if (fd < 0) co_return errno_error{errno};
+    if (!options.apply(fd)) {
+      int error = errno;
+      close(fd);
+      co_return errno_error{error};
+    }
+    int rv = co_await async_connect(fd, target.sockaddr(), target.length());
+    if (rv < 0) {
+      close(fd);
+      co_return errno_error{-rv};
+    }
     co_return tcp_socket(target, fd);
   }
   tcp_socket(tcp_socket&& rhs) {
@@ -33,6 +49,8 @@ struct tcp_socket {
     rhs.fd = -1;
   }
   tcp_socket& operator=(tcp_socket&& rhs) {
+    if (this == &rhs) return *this;
+    if (fd != -1) close(fd);
     fd = rhs.fd;
     target = rhs.target;
     rhs.target = {};
@@ -40,9 +58,19 @@ struct tcp_socket {
     return *this;
   }
   ~tcp_socket() {
-    close(fd);
+    if (fd != -1)
+      close(fd);
+  }
+  // For handing the connection to another process, see unix_stream_socket.
+  int native_handle() const {
+    return fd;
   }
-  future<size_t> recvmsg(uint8_t* p, size_t count) {
+  // False with errno set if an option could not be set.
+  bool set_options(const socket_options& options) {
+    return options.apply(fd);
+  }
+  // Bytes received, 0 once the peer has closed.
+  future<result<size_t>> recvmsg(uint8_t* p, size_t count) {
     struct iovec iov = { p, count };
     struct msghdr hdr;
     hdr.msg_name = nullptr;
@@ -52,10 +80,10 @@ struct tcp_socket {
     hdr.msg_control = 0;
     hdr.msg_controllen = 0;
     hdr.msg_flags = 0;
-    ssize_t recvres = co_await async_recvmsg(fd, &hdr, 0);
-    co_return recvres >= 0 ? recvres : 0;
+    co_return syscall_result<size_t>(co_await async_recvmsg(fd, &hdr, 0));
   }
-  future<Void> sendmsg(std::span<const uint8_t> msg) {
+  // Bytes sent, which can be fewer than msg.size().
+  future<result<size_t>> sendmsg(std::span<const uint8_t> msg) {
     struct iovec iov = { (void*)msg.data(), msg.size() };
     struct msghdr hdr;
     hdr.msg_name = nullptr;
@@ -65,12 +93,18 @@ struct tcp_socket {
     hdr.msg_control = 0;
     hdr.msg_controllen = 0;
     hdr.msg_flags = 0;
-    ssize_t res = co_await async_sendmsg(fd, &hdr, 0);
-    if (res == -1) {
-      printf("async_sendmsg error");
-      exit(-1);
+    pending_send accounting(msg.size());
+    co_return syscall_result<size_t>(co_await async_sendmsg(fd, &hdr, MSG_NOSIGNAL));
+  }
+  // What each receive into `buffer` got, until the peer closes. A chunk is
+  // only valid until the next one is requested.
+  async_generator<std::span<const uint8_t>> stream(std::span<uint8_t> buffer) {
+    for (;;) {
+      ssize_t bytes = co_await async_recv(fd, buffer.data(), buffer.size(), 0);
+      if (bytes < 0) co_yield errno_error{int(-bytes)};
+      if (bytes <= 0) co_return;
+      co_yield std::span<const uint8_t>(buffer.data(), bytes);
     }
-    co_return {};
   }
 private:
   network_address target;
@@ -78,19 +112,52 @@ private:
 };
 
 struct tcp_listen_socket {
-  tcp_listen_socket(network_address listen_address, std::function<void(tcp_socket)> onConnect) {
-    // TODO: handle errors
-    fd = socket(AF_INET, SOCK_STREAM, 0);
-    bind(fd, listen_address.sockaddr(), listen_address.length());
-    listen(fd, 5);
+  tcp_listen_socket(network_address listen_address, std::function<void(tcp_socket)> onConnect) 
+  : tcp_listen_socket(listen_fd(listen_address), std::move(onConnect))
+  {
+  }
+  tcp_listen_socket(network_address listen_address, const socket_options& options, std::function<void(tcp_socket)> onConnect) 
+  : tcp_listen_socket(listen_fd(listen_address, options), std::move(onConnect))
+  {
+  }
+  // Takes over an already listening socket and accepts on the calling thread's ring.
+  tcp_listen_socket(int fd, std::function<void(tcp_socket)> onConnect) 
+  : fd(fd)
+  {
     acceptLoopF = acceptLoop(std::move(onConnect));
   }
+  static int listen_fd(const network_address& listen_address, bool reuseport = false, int backlog = 5) {
+    socket_options options;
+    options.reusePort = reuseport;
+    return listen_fd(listen_address, options, backlog);
+  }
+  // -1 if the socket could not be set up, bound or listened on, with errno set.
+  static int listen_fd(const network_address& listen_address, const socket_options& options, int backlog = SOMAXCONN) {
+    int fd = socket(listen_address.family(), SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (!options.apply(fd) || bind(fd, listen_address.sockaddr(), listen_address.length()) < 0 || listen(fd, backlog) < 0) {
+      int error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    return fd;
+  }
   future<Void> acceptLoop(std::function<void(tcp_socket)> onConnect) {
     while (not done) {
+      co_await async_admit();
       network_address addr;
       addr.resize(sizeof(sockaddr_in6));
       int newFd = co_await async_accept(fd, addr.sockaddr(), &addr.length(), 0);
-//      if (error)  TODO
+      if (newFd < 0) {
+        // shutdown() on the listening socket ends the loop
+        if (newFd == -EINVAL || newFd == -EBADF) break;
+        if (accept_exhausted(newFd)) {
+          __kernel_timespec pause = { 0, 10000000 };
+          co_await async_timeout(&pause);
+        }
+        continue;
+      }
       onConnect(tcp_socket(addr, newFd));
     }
     co_return {};
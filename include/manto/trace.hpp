@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Coroutine and io_uring request tracing, compiled in with MANTO_TRACE.
+// Each thread appends to its own fixed-size ring of events, overwriting the
+// oldest; trace_dump writes all threads' rings as Chrome trace JSON, which
+// chrome://tracing and ui.perfetto.dev load directly. Coroutines show up as
+// async slices with a nested "await" slice while parked, whose args name the
+// coroutine or request it waits on, so a slow request can be followed down its
+// await chain.
+enum class trace_kind : uint8_t {
+  coroutine_begin,
+  coroutine_end,
+  await_begin,
+  await_end,
+  op_begin,
+  op_end,
+};
+
+struct trace_event {
+  uint64_t ts;
+  const void* id;
+  const void* target;
+  int32_t value;
+  trace_kind kind;
+  uint8_t opcode;
+};
+
+#ifdef MANTO_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+struct trace_buffer {
+  static constexpr size_t capacity = 1 << 16;
+  std::unique_ptr<trace_event[]> events = std::make_unique<trace_event[]>(capacity);
+  std::atomic<uint64_t> head = 0;
+  uint32_t tid;
+  void push(trace_event e) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    events[h & (capacity - 1)] = e;
+    head.store(h + 1, std::memory_order_release);
+  }
+};
+
+// Trace one in `oneIn` coroutines and requests, picked by address so that all
+// events of a traced one are kept; 0 turns tracing off. Defaults to 1.
+void trace_set_sampling(unsigned oneIn);
+trace_buffer& trace_thread_buffer();
+// Writes the events of every thread that traced so far. Threads still running
+// may lose their newest few events to the race with the reader.
+void trace_dump(FILE* out);
+
+extern std::atomic<unsigned> trace_sampling;
+
+inline bool trace_sampled(const void* id) {
+  unsigned oneIn = trace_sampling.load(std::memory_order_relaxed);
+  if (oneIn <= 1) return oneIn == 1;
+  uint64_t h = (uint64_t)(uintptr_t)id * 0x9E3779B97F4A7C15ULL;
+  return (h >> 32) % oneIn == 0;
+}
+
+inline void trace_record(trace_kind kind, const void* id, const void* target = nullptr, int32_t value = 0, uint8_t opcode = 0) {
+  if (!trace_sampled(id)) return;
+  uint64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  trace_thread_buffer().push({ts, id, target, value, kind, opcode});
+}
+
+#else
+
+inline void trace_record(trace_kind, const void*, const void* = nullptr, int32_t = 0, uint8_t = 0) {}
+
+#endif
@@ -1,28 +1,58 @@
 #pragma once
 
+#include "manto/async_generator.hpp"
 #include "manto/async_syscall.hpp"
 #include "manto/future.hpp"
 #include "manto/network_address.hpp"
+#include "manto/socket_options.hpp"
+#include <memory>
 #include <vector>
 #include <span>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/udp.h>
 #include <unistd.h>
 
-struct udp_socket {
-  udp_socket(uint16_t port = 0) {
-    fd = socket(AF_INET, SOCK_DGRAM, 0);
+struct udp_message {
+  network_address target;
+  std::span<const uint8_t> data;
+};
 
-    if (port) {
-      struct sockaddr_in in;
+struct udp_datagram {
+  const network_address* source;
+  std::span<const uint8_t> data;
+};
+
+struct udp_socket {
+  // Bound to `port` (any free one for 0) on all addresses of `family`; use
+  // AF_INET6 to reach IPv6 targets.
+  udp_socket(uint16_t port = 0, int family = AF_INET) {
+    if (family == AF_INET6) {
+      struct sockaddr_in6 in = {};
+      in.sin6_family = AF_INET6;
+      in.sin6_port = htons(port);
+      in.sin6_addr = in6addr_any;
+      open(network_address(reinterpret_cast<const struct sockaddr*>(&in), sizeof(in)), {});
+    } else {
+      struct sockaddr_in in = {};
       in.sin_family = AF_INET;
       in.sin_port = htons(port);
       in.sin_addr.s_addr = htonl(INADDR_ANY);
-      bind(fd, reinterpret_cast<const struct sockaddr*>(&in), sizeof(in));
+      open(network_address(reinterpret_cast<const struct sockaddr*>(&in), sizeof(in)), {});
     }
   }
+  udp_socket(const network_address& bindAddress, bool reuseport = false) {
+    socket_options options;
+    options.reusePort = reuseport;
+    open(bindAddress, options);
+  }
+  // The socket is of bindAddress's family; bind to "[::]:port" for IPv6. If
+  // it cannot be opened, configured or bound, fd is -1 and errno says why.
+  udp_socket(const network_address& bindAddress, const socket_options& options) {
+    open(bindAddress, options);
+  }
   udp_socket(udp_socket&& rhs) {
     fd = rhs.fd;
     rhs.fd = -1;
@@ -36,7 +66,7 @@ struct udp_socket {
     if (fd != -1)
       close(fd);
   }
-  future<std::pair<network_address, std::vector<uint8_t>>> recvmsg(size_t maxSize) {
+  future<result<std::pair<network_address, std::vector<uint8_t>>>> recvmsg(size_t maxSize) {
     char namebuf[128];
     std::vector<unsigned char> msgbuf;
     msgbuf.resize(maxSize);
@@ -50,12 +80,13 @@ struct udp_socket {
     hdr.msg_controllen = 0;
     hdr.msg_flags = 0;
     ssize_t recvres = co_await async_recvmsg(fd, &hdr, 0);
+    if (recvres < 0) co_return errno_error{int(-recvres)};
     msgbuf.resize(recvres);
     // TODO: workaround for Clang9 bug, temporary network_address storage
     network_address addr((const struct sockaddr*)hdr.msg_name, (socklen_t)hdr.msg_namelen);
-    co_return {std::move(addr), std::move(msgbuf)};
+    co_return std::pair{std::move(addr), std::move(msgbuf)};
   }
-  future<Void> sendmsg(network_address target, std::span<const uint8_t> msg) {
+  future<result<size_t>> sendmsg(network_address target, std::span<const uint8_t> msg) {
     struct iovec iov = { (void*)msg.data(), msg.size() };
     struct msghdr hdr;
     hdr.msg_name = target.sockaddr();
@@ -65,9 +96,280 @@ struct udp_socket {
     hdr.msg_control = 0;
     hdr.msg_controllen = 0;
     hdr.msg_flags = 0;
-    co_await async_sendmsg(fd, &hdr, 0);
-    co_return {};
+    pending_send accounting(msg.size());
+    co_return syscall_result<size_t>(co_await async_sendmsg(fd, &hdr, 0));
+  }
+  // Sends all messages as a batch of sendmsg requests from this coroutine. The
+  // batch goes to the kernel one SQ's worth per submit, so it only takes a
+  // single one if ring_config::entries is at least the number of messages.
+  // Returns how many were sent, or the first error if none were.
+  future<result<size_t>> sendmsgs(std::span<const udp_message> msgs) {
+    std::vector<struct iovec> iovs(msgs.size());
+    std::vector<struct msghdr> hdrs(msgs.size());
+    std::vector<syscall_rv_base> results(msgs.size());
+    size_t bytes = 0;
+    for (const udp_message& m : msgs)
+      bytes += m.data.size();
+    pending_send accounting(bytes);
+    for (size_t n = 0; n < msgs.size(); n++) {
+      iovs[n] = { (void*)msgs[n].data.data(), msgs[n].data.size() };
+      hdrs[n].msg_name = (void*)msgs[n].target.sockaddr();
+      hdrs[n].msg_namelen = msgs[n].target.length();
+      hdrs[n].msg_iov = &iovs[n];
+      hdrs[n].msg_iovlen = 1;
+      hdrs[n].msg_control = 0;
+      hdrs[n].msg_controllen = 0;
+      hdrs[n].msg_flags = 0;
+      io_uring_sqe* s = get_ring().get_sqe();
+      io_uring_prep_sendmsg(s, fd, &hdrs[n], 0);
+      results[n].attach(s);
+    }
+    size_t sent = 0;
+    int error = 0;
+    for (auto& r : results) {
+      int32_t res = co_await r;
+      if (res >= 0) sent++;
+      else if (!error) error = -res;
+    }
+    if (sent == 0 && error) co_return errno_error{error};
+    co_return sent;
+  }
+  // Sends `data` to one target as datagrams of `segmentSize` bytes (the last one
+  // may be shorter), letting the kernel do the segmentation (UDP_SEGMENT). Data
+  // beyond what one GSO send can carry is split over several requests, batched
+  // like sendmsgs(). Returns how many datagrams were sent, or the first error
+  // if none were.
+  future<result<size_t>> sendmsg_gso(network_address target, std::span<const uint8_t> data, uint16_t segmentSize) {
+    static constexpr size_t maxSegments = 64, maxBytes = 65507;
+    if (segmentSize == 0 || segmentSize > maxBytes) co_return errno_error{EINVAL};
+    size_t chunkSize = segmentSize * std::min(maxSegments, maxBytes / segmentSize);
+    size_t count = (data.size() + chunkSize - 1) / chunkSize;
+    std::vector<struct iovec> iovs(count);
+    std::vector<struct msghdr> hdrs(count);
+    std::vector<syscall_rv_base> results(count);
+    pending_send accounting(data.size());
+    // Not a local array: coroutine frames do not reliably honour its alignment.
+    std::vector<struct cmsghdr> control(CMSG_SPACE(sizeof(uint16_t)) / sizeof(struct cmsghdr) + 1);
+    for (size_t n = 0; n < count; n++) {
+      std::span<const uint8_t> chunk = data.subspan(n * chunkSize, std::min(chunkSize, data.size() - n * chunkSize));
+      iovs[n] = { (void*)chunk.data(), chunk.size() };
+      hdrs[n].msg_name = target.sockaddr();
+      hdrs[n].msg_namelen = target.length();
+      hdrs[n].msg_iov = &iovs[n];
+      hdrs[n].msg_iovlen = 1;
+      hdrs[n].msg_flags = 0;
+      if (chunk.size() > segmentSize) {
+        hdrs[n].msg_control = control.data();
+        hdrs[n].msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        struct cmsghdr* c = CMSG_FIRSTHDR(&hdrs[n]);
+        c->cmsg_level = SOL_UDP;
+        c->cmsg_type = UDP_SEGMENT;
+        c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(c), &segmentSize, sizeof(segmentSize));
+      } else {
+        hdrs[n].msg_control = 0;
+        hdrs[n].msg_controllen = 0;
+      }
+      io_uring_sqe* s = get_ring().get_sqe();
+      io_uring_prep_sendmsg(s, fd, &hdrs[n], 0);
+      results[n].attach(s);
+    }
+    size_t sent = 0;
+    int error = 0;
+    for (size_t n = 0; n < count; n++) {
+      ssize_t res = co_await results[n];
+      if (res > 0) sent += (res + segmentSize - 1) / segmentSize;
+      else if (res < 0 && !error) error = -res;
+    }
+    if (sent == 0 && error) co_return errno_error{error};
+    co_return sent;
+  }
+  // Lets the kernel coalesce consecutive datagrams from one sender into a single
+  // receive. Only useful together with udp_receiver, which splits them again.
+  bool enable_gro() {
+    int on = 1;
+    return setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+  }
+  // Each datagram as it arrives, received into `buffer` one at a time; a
+  // datagram and its source are only valid until the next one is requested.
+  // udp_receiver keeps more receives in flight when that matters. Ends once
+  // the socket is shut down for reading.
+  async_generator<udp_datagram> stream(std::span<uint8_t> buffer) {
+    network_address source;
+    for (;;) {
+      source.resize(sizeof(sockaddr_in6));
+      struct iovec iov = { buffer.data(), buffer.size() };
+      struct msghdr hdr = {};
+      hdr.msg_name = source.sockaddr();
+      hdr.msg_namelen = source.length();
+      hdr.msg_iov = &iov;
+      hdr.msg_iovlen = 1;
+      ssize_t bytes = co_await async_recvmsg(fd, &hdr, 0);
+      if (bytes < 0) {
+        co_yield errno_error{int(-bytes)};
+        co_return;
+      }
+      // Shut down for reading; an empty datagram still has a sender.
+      if (bytes == 0 && hdr.msg_namelen == 0) co_return;
+      source.resize(hdr.msg_namelen);
+      co_yield udp_datagram{&source, {buffer.data(), (size_t)bytes}};
+    }
   }
   int fd;
+private:
+  void open(const network_address& bindAddress, const socket_options& options) {
+    fd = socket(bindAddress.family(), SOCK_DGRAM, 0);
+    if (fd < 0) return;
+    if (!options.apply(fd) || bind(fd, bindAddress.sockaddr(), bindAddress.length()) < 0) {
+      int error = errno;
+      close(fd);
+      fd = -1;
+      errno = error;
+    }
+  }
+};
+
+// Keeps `depth` recvmsg requests in flight on a socket, each receiving into its
+// own buffer from one pooled allocation. recvmsgs() hands out everything that
+// arrived since the last call; the returned datagrams stay valid until the next
+// call, at which point their buffers are re-armed. A receive that fails with
+// anything but a transient error stops its slot and is reported by error().
+struct udp_receiver {
+  udp_receiver(udp_socket& sock, size_t depth = 32, size_t bufferSize = 2048, bool gro = false)
+  : st(std::make_shared<state>())
+  {
+    if (gro && sock.enable_gro()) 
+      bufferSize = std::max<size_t>(bufferSize, 65535);
+    st->fd = sock.fd;
+    st->pool.resize(depth * bufferSize);
+    st->slots.resize(depth);
+    for (size_t n = 0; n < depth; n++) {
+      st->slots[n].buffer = {st->pool.data() + n * bufferSize, bufferSize};
+      slotLoop(st, &st->slots[n]);
+    }
+  }
+  udp_receiver(udp_receiver&& rhs) = default;
+  udp_receiver& operator=(udp_receiver&& rhs) = default;
+  ~udp_receiver() {
+    if (!st) return;
+    st->closed = true;
+    for (auto& s : st->slots) {
+      if (s.pending) s.pending->cancel();
+      if (s.released) std::exchange(s.released, {}).resume();
+    }
+  }
+  future<std::span<const udp_datagram>> recvmsgs() {
+    std::shared_ptr<state> st = this->st;
+    for (slot* s : st->handedOut) {
+      std::exchange(s->released, {}).resume();
+    }
+    st->handedOut.clear();
+    st->batch.clear();
+    if (st->ready.empty() && !st->error) 
+      co_await wait_ready{st.get()};
+    std::swap(st->ready, st->handedOut);
+    for (slot* s : st->handedOut) {
+      std::span<const uint8_t> data = s->buffer.subspan(0, s->length);
+      size_t segment = s->segment ? s->segment : data.size();
+      do {
+        size_t len = std::min(segment, data.size());
+        st->batch.push_back({&s->source, data.subspan(0, len)});
+        data = data.subspan(len);
+      } while (!data.empty());
+    }
+    co_return std::span<const udp_datagram>(st->batch);
+  }
+  // The first error that stopped a slot, or 0; ESHUTDOWN once the socket has
+  // been shut down for reading. Once set, recvmsgs() returns an empty batch
+  // instead of waiting when nothing has arrived.
+  int error() const {
+    return st->error;
+  }
+private:
+  struct slot {
+    std::span<uint8_t> buffer;
+    size_t length = 0;
+    size_t segment = 0;
+    network_address source;
+    syscall_rv_base* pending = nullptr;
+    std::coroutine_handle<> released;
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  };
+  struct state {
+    int fd = -1;
+    bool closed = false;
+    int error = 0;
+    std::vector<uint8_t> pool;
+    std::vector<slot> slots;
+    std::vector<slot*> ready, handedOut;
+    std::vector<udp_datagram> batch;
+    std::coroutine_handle<> waiting;
+  };
+  struct wait_ready {
+    state* st;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h) { st->waiting = h; }
+    void await_resume() {}
+  };
+  // Parks a slot with its data until the consumer is done with it, waking the
+  // consumer if it is waiting.
+  struct wait_released {
+    state* st;
+    slot* s;
+    bool await_ready() { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+      s->released = h;
+      st->ready.push_back(s);
+      if (st->waiting) 
+        return std::exchange(st->waiting, {});
+      return std::noop_coroutine();
+    }
+    void await_resume() {}
+  };
+  static future<Void> slotLoop(std::shared_ptr<state> st, slot* s) {
+    char namebuf[sizeof(struct sockaddr_in6)];
+    while (not st->closed) {
+      struct iovec iov = { s->buffer.data(), s->buffer.size() };
+      struct msghdr hdr;
+      hdr.msg_name = namebuf;
+      hdr.msg_namelen = sizeof(namebuf);
+      hdr.msg_iov = &iov;
+      hdr.msg_iovlen = 1;
+      hdr.msg_control = s->control;
+      hdr.msg_controllen = sizeof(s->control);
+      hdr.msg_flags = 0;
+      auto rv = async_recvmsg(st->fd, &hdr, 0);
+      s->pending = &rv;
+      ssize_t recvres = co_await rv;
+      s->pending = nullptr;
+      if (st->closed || recvres == -EBADF || recvres == -ENOTSOCK || recvres == -ECANCELED) 
+        break;
+      // An ICMP error for an earlier send on a connected socket, or a signal.
+      if (recvres == -ECONNREFUSED || recvres == -EINTR) 
+        continue;
+      // Nothing received and no sender: the socket was shut down for reading
+      // (see sharded_udp_socket), and every receive from here on is the same.
+      if (recvres == 0 && hdr.msg_namelen == 0) 
+        recvres = -ESHUTDOWN;
+      if (recvres < 0) {
+        if (!st->error) st->error = -recvres;
+        if (st->waiting) std::exchange(st->waiting, {}).resume();
+        break;
+      }
+      s->length = recvres;
+      s->segment = 0;
+      for (struct cmsghdr* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(&hdr, c)) {
+        if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+          int segment;
+          memcpy(&segment, CMSG_DATA(c), sizeof(segment));
+          s->segment = segment;
+        }
+      }
+      s->source = network_address((const struct sockaddr*)namebuf, (socklen_t)hdr.msg_namelen);
+      co_await wait_released{st.get(), s};
+    }
+    co_return {};
+  }
+  std::shared_ptr<state> st;
 };
 
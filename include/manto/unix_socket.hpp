@@ -0,0 +1,248 @@
+#pragma once
+
+#include "manto/async_syscall.hpp"
+#include "manto/future.hpp"
+#include "manto/network_address.hpp"
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Ancillary data for passing descriptors with SCM_RIGHTS. The kernel installs
+// received descriptors in this process and they belong to the receiver, which
+// has to close them. Descriptors past max_fds in one message are dropped.
+struct unix_fd_buffer {
+  static constexpr unsigned max_fds = 64;
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_fds)];
+
+  // Returns false if there are more than max_fds.
+  bool attach(struct msghdr& hdr, std::span<const int> fds) {
+    if (fds.empty()) return true;
+    if (fds.size() > max_fds) return false;
+    hdr.msg_control = control;
+    hdr.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    struct cmsghdr* c = CMSG_FIRSTHDR(&hdr);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(c), fds.data(), sizeof(int) * fds.size());
+    return true;
+  }
+  void prepare(struct msghdr& hdr) {
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+  }
+  // Appends what arrived to `fds`, or closes it if the caller did not ask.
+  void collect(const struct msghdr& hdr, std::vector<int>* fds) {
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(const_cast<struct msghdr*>(&hdr), c)) {
+      if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+      size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t n = 0; n < count; n++) {
+        int fd;
+        memcpy(&fd, CMSG_DATA(c) + n * sizeof(int), sizeof(int));
+        if (fds)
+          fds->push_back(fd);
+        else
+          close(fd);
+      }
+    }
+  }
+};
+
+// A connected AF_UNIX stream socket. Besides bytes it carries descriptors,
+// e.g. accepted connections handed from a front process to its workers:
+//
+//   co_await worker.sendmsg(header, std::array{conn.native_handle()});
+//   ...
+//   std::vector<int> fds;
+//   co_await front.recvmsg(buffer, sizeof(buffer), &fds);
+//   tcp_socket conn(network_address(), fds[0]);
+struct unix_stream_socket {
+  friend struct unix_listen_socket;
+  unix_stream_socket()
+  : fd(-1)
+  {}
+  explicit unix_stream_socket(int fd)
+  : fd(fd)
+  {}
+  static future<result<unix_stream_socket>> create(network_address target) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) co_return errno_error{errno};
+    int rv = co_await async_connect(fd, target.sockaddr(), target.length());
+    if (rv < 0) {
+      close(fd);
+      co_return errno_error{-rv};
+    }
+    co_return unix_stream_socket(fd);
+  }
+  // Two connected sockets, e.g. to hand one to a child process.
+  static result<std::pair<unix_stream_socket, unix_stream_socket>> create_pair() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) return errno_error{errno};
+    return std::pair(unix_stream_socket(fds[0]), unix_stream_socket(fds[1]));
+  }
+  unix_stream_socket(unix_stream_socket&& rhs)
+  : fd(std::exchange(rhs.fd, -1))
+  {}
+  unix_stream_socket& operator=(unix_stream_socket&& rhs) {
+    if (this == &rhs) return *this;
+    if (fd != -1) close(fd);
+    fd = std::exchange(rhs.fd, -1);
+    return *this;
+  }
+  ~unix_stream_socket() {
+    if (fd != -1)
+      close(fd);
+  }
+  int native_handle() const {
+    return fd;
+  }
+  // Bytes received, 0 once the peer has closed. Descriptors sent along with
+  // them are appended to `fds`, or closed if it is null.
+  future<result<size_t>> recvmsg(uint8_t* p, size_t count, std::vector<int>* fds = nullptr) {
+    struct iovec iov = { p, count };
+    struct msghdr hdr = {};
+    unix_fd_buffer control;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    control.prepare(hdr);
+    int rv = co_await async_recvmsg(fd, &hdr, MSG_CMSG_CLOEXEC);
+    if (rv >= 0) control.collect(hdr, fds);
+    co_return syscall_result<size_t>(rv);
+  }
+  // Bytes sent, which can be fewer than msg.size(). The descriptors go with
+  // the first byte, so msg must not be empty when there are any.
+  future<result<size_t>> sendmsg(std::span<const uint8_t> msg, std::span<const int> fds = {}) {
+    struct iovec iov = { (void*)msg.data(), msg.size() };
+    struct msghdr hdr = {};
+    unix_fd_buffer control;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    if (!control.attach(hdr, fds)) co_return errno_error{EINVAL};
+    pending_send accounting(msg.size());
+    co_return syscall_result<size_t>(co_await async_sendmsg(fd, &hdr, MSG_NOSIGNAL));
+  }
+private:
+  int fd;
+};
+
+// Accepts on the calling thread's ring, like tcp_listen_socket. A filesystem
+// path must not exist yet; remove stale socket files before listening.
+struct unix_listen_socket {
+  unix_listen_socket(network_address listen_address, std::function<void(unix_stream_socket)> onConnect)
+  : unix_listen_socket(listen_fd(listen_address), std::move(onConnect))
+  {
+  }
+  unix_listen_socket(int fd, std::function<void(unix_stream_socket)> onConnect)
+  : fd(fd)
+  {
+    acceptLoopF = acceptLoop(std::move(onConnect));
+  }
+  // -1 if the socket could not be bound or listened on, with errno set.
+  static int listen_fd(const network_address& listen_address, int backlog = SOMAXCONN) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, listen_address.sockaddr(), listen_address.length()) < 0 || listen(fd, backlog) < 0) {
+      int error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    return fd;
+  }
+  future<Void> acceptLoop(std::function<void(unix_stream_socket)> onConnect) {
+    while (true) {
+      co_await async_admit();
+      int newFd = co_await async_accept(fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (newFd < 0) {
+        // shutdown() on the listening socket ends the loop
+        if (newFd == -EINVAL || newFd == -EBADF) break;
+        if (accept_exhausted(newFd)) {
+          __kernel_timespec pause = { 0, 10000000 };
+          co_await async_timeout(&pause);
+        }
+        continue;
+      }
+      onConnect(unix_stream_socket(newFd));
+    }
+    co_return {};
+  }
+  ~unix_listen_socket() {
+    close(fd);
+  }
+  int fd;
+  future<Void> acceptLoopF;
+};
+
+// An AF_UNIX datagram socket. Message boundaries are kept and, unlike UDP,
+// nothing is lost or reordered; a full receiver makes the sender wait.
+struct unix_dgram_socket {
+  unix_dgram_socket()
+  : fd(socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0))
+  {}
+  explicit unix_dgram_socket(const network_address& bindAddress)
+  : unix_dgram_socket()
+  {
+    bind(fd, bindAddress.sockaddr(), bindAddress.length());
+  }
+  explicit unix_dgram_socket(int fd)
+  : fd(fd)
+  {}
+  static result<std::pair<unix_dgram_socket, unix_dgram_socket>> create_pair() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) < 0) return errno_error{errno};
+    return std::pair(unix_dgram_socket(fds[0]), unix_dgram_socket(fds[1]));
+  }
+  unix_dgram_socket(unix_dgram_socket&& rhs)
+  : fd(std::exchange(rhs.fd, -1))
+  {}
+  unix_dgram_socket& operator=(unix_dgram_socket&& rhs) {
+    if (this == &rhs) return *this;
+    if (fd != -1) close(fd);
+    fd = std::exchange(rhs.fd, -1);
+    return *this;
+  }
+  ~unix_dgram_socket() {
+    if (fd != -1)
+      close(fd);
+  }
+  // The datagram's size; longer datagrams are truncated to `count`. The sender
+  // goes into `source` if given, which stays empty for unbound senders.
+  future<result<size_t>> recvmsg(uint8_t* p, size_t count, network_address* source = nullptr, std::vector<int>* fds = nullptr) {
+    struct iovec iov = { p, count };
+    struct msghdr hdr = {};
+    unix_fd_buffer control;
+    if (source) {
+      source->resize(sizeof(sockaddr_un));
+      hdr.msg_name = source->sockaddr();
+      hdr.msg_namelen = source->length();
+    }
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    control.prepare(hdr);
+    int rv = co_await async_recvmsg(fd, &hdr, MSG_CMSG_CLOEXEC);
+    if (source) source->resize(rv >= 0 && hdr.msg_namelen > sizeof(sa_family_t) ? hdr.msg_namelen : 0);
+    if (rv >= 0) control.collect(hdr, fds);
+    co_return syscall_result<size_t>(rv);
+  }
+  // To the connected peer when `target` is empty.
+  future<result<size_t>> sendmsg(const network_address& target, std::span<const uint8_t> msg, std::span<const int> fds = {}) {
+    struct iovec iov = { (void*)msg.data(), msg.size() };
+    struct msghdr hdr = {};
+    unix_fd_buffer control;
+    if (target.valid()) {
+      hdr.msg_name = (void*)target.sockaddr();
+      hdr.msg_namelen = target.length();
+    }
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    if (!control.attach(hdr, fds)) co_return errno_error{EINVAL};
+    pending_send accounting(msg.size());
+    co_return syscall_result<size_t>(co_await async_sendmsg(fd, &hdr, 0));
+  }
+  int fd;
+};
@@ -0,0 +1,225 @@
+#include "manto/checksum.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace {
+  constexpr uint32_t crc32c_poly = 0x82f63b78; // reflected
+
+  // Slice-by-8 tables for CPUs without the crc32 instruction.
+  constexpr std::array<std::array<uint32_t, 256>, 8> crc32c_tables = [] {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? (c >> 1) ^ crc32c_poly : c >> 1;
+      t[0][n] = c;
+    }
+    for (uint32_t n = 0; n < 256; n++)
+      for (int k = 1; k < 8; k++)
+        t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xff];
+    return t;
+  }();
+
+  uint32_t crc32c_portable(uint32_t crc, const uint8_t* p, size_t n) {
+    for (; n >= 8; p += 8, n -= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      word ^= crc;
+      crc = crc32c_tables[7][word & 0xff] ^ crc32c_tables[6][(word >> 8) & 0xff]
+          ^ crc32c_tables[5][(word >> 16) & 0xff] ^ crc32c_tables[4][(word >> 24) & 0xff]
+          ^ crc32c_tables[3][(word >> 32) & 0xff] ^ crc32c_tables[2][(word >> 40) & 0xff]
+          ^ crc32c_tables[1][(word >> 48) & 0xff] ^ crc32c_tables[0][word >> 56];
+    }
+    for (; n; p++, n--)
+      crc = (crc >> 8) ^ crc32c_tables[0][(crc ^ *p) & 0xff];
+    return crc;
+  }
+
+#if defined(__x86_64__)
+  // a * b mod P, both reflected.
+  constexpr uint32_t multiply_mod(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t m = 1u << 31; m; m >>= 1) {
+      if (a & m) product ^= b;
+      b = b & 1 ? (b >> 1) ^ crc32c_poly : b >> 1;
+    }
+    return product;
+  }
+
+  // x^bits mod P.
+  constexpr uint32_t power_of_x(size_t bits) {
+    uint32_t result = 1u << 31; // x^0
+    uint32_t square = 1u << 30; // x^1, squared up to x^(2^k)
+    for (; bits; bits >>= 1) {
+      if (bits & 1) result = multiply_mod(square, result);
+      square = multiply_mod(square, square);
+    }
+    return result;
+  }
+
+  // crc * k * x^33 mod P: a carry-less multiply reduced by the crc32
+  // instruction, which multiplies by x^32 on the way; the reflected product
+  // adds the other x. Moving a register past n bytes takes k = x^(8n-33).
+  __attribute__((target("sse4.2,pclmul")))
+  uint32_t shift(uint32_t crc, uint32_t k) {
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(k), 0);
+    return _mm_crc32_u64(0, _mm_cvtsi128_si64(product));
+  }
+
+  // The crc32 instruction has a latency of three cycles but a throughput of
+  // one, so long buffers are split into three lanes run side by side, and the
+  // lanes' registers are folded together at the end of each stripe.
+  template <size_t lane>
+  struct stripe {
+    static constexpr uint32_t shift1 = power_of_x(8 * lane - 33);
+    static constexpr uint32_t shift2 = power_of_x(16 * lane - 33);
+  };
+
+  template <size_t lane>
+  __attribute__((target("sse4.2,pclmul")))
+  uint32_t crc32c_stripes(uint32_t crc, const uint8_t*& p, size_t& n) {
+    for (; n >= 3 * lane; p += 3 * lane, n -= 3 * lane) {
+      uint64_t c0 = crc, c1 = 0, c2 = 0;
+      for (size_t off = 0; off < lane; off += 8) {
+        uint64_t w0, w1, w2;
+        memcpy(&w0, p + off, 8);
+        memcpy(&w1, p + lane + off, 8);
+        memcpy(&w2, p + 2 * lane + off, 8);
+        c0 = _mm_crc32_u64(c0, w0);
+        c1 = _mm_crc32_u64(c1, w1);
+        c2 = _mm_crc32_u64(c2, w2);
+      }
+      crc = shift(uint32_t(c0), stripe<lane>::shift2) ^ shift(uint32_t(c1), stripe<lane>::shift1) ^ uint32_t(c2);
+    }
+    return crc;
+  }
+
+  __attribute__((target("sse4.2,pclmul")))
+  uint32_t crc32c_hardware(uint32_t crc, const uint8_t* p, size_t n) {
+    crc = crc32c_stripes<4096>(crc, p, n);
+    crc = crc32c_stripes<256>(crc, p, n);
+    uint64_t c = crc;
+    for (; n >= 8; p += 8, n -= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      c = _mm_crc32_u64(c, word);
+    }
+    crc = uint32_t(c);
+    for (; n; p++, n--)
+      crc = _mm_crc32_u8(crc, *p);
+    return crc;
+  }
+#endif
+
+  using crc32c_fn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+  crc32c_fn pick_crc32c() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")) return crc32c_hardware;
+#endif
+    return crc32c_portable;
+  }
+
+  constexpr uint64_t prime1 = 11400714785074694791ull;
+  constexpr uint64_t prime2 = 14029467366897019727ull;
+  constexpr uint64_t prime3 = 1609587929392839161ull;
+  constexpr uint64_t prime4 = 9650029242287828579ull;
+  constexpr uint64_t prime5 = 2870177450012600261ull;
+
+  uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+  }
+
+  uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+
+  uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * prime2, 31) * prime1;
+  }
+
+  uint64_t xxh_merge(uint64_t h, uint64_t acc) {
+    return (h ^ xxh_round(0, acc)) * prime1 + prime4;
+  }
+
+  // The main loop: four independent lanes over 32-byte stripes.
+  const uint8_t* xxh_stripes(uint64_t (&acc)[4], const uint8_t* p, const uint8_t* end) {
+    for (; end - p >= 32; p += 32) {
+      acc[0] = xxh_round(acc[0], load64(p));
+      acc[1] = xxh_round(acc[1], load64(p + 8));
+      acc[2] = xxh_round(acc[2], load64(p + 16));
+      acc[3] = xxh_round(acc[3], load64(p + 24));
+    }
+    return p;
+  }
+}
+
+uint32_t crc32c_update(uint32_t state, std::span<const uint8_t> data) {
+  static const crc32c_fn fn = pick_crc32c();
+  return fn(state, data.data(), data.size());
+}
+
+xxhash64::xxhash64(uint64_t seed)
+: seed(seed)
+, acc{ seed + prime1 + prime2, seed + prime2, seed, seed - prime1 }
+{
+}
+
+void xxhash64::update(std::span<const uint8_t> data) {
+  const uint8_t* p = data.data();
+  const uint8_t* end = p + data.size();
+  total += data.size();
+  if (pendingBytes) {
+    size_t take = std::min(sizeof(pending) - pendingBytes, data.size());
+    memcpy(pending + pendingBytes, p, take);
+    pendingBytes += take;
+    p += take;
+    if (pendingBytes < sizeof(pending)) return;
+    xxh_stripes(acc, pending, pending + sizeof(pending));
+    pendingBytes = 0;
+  }
+  p = xxh_stripes(acc, p, end);
+  memcpy(pending, p, end - p);
+  pendingBytes = end - p;
+}
+
+uint64_t xxhash64::value() const {
+  uint64_t h;
+  if (total >= 32) {
+    h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+    for (uint64_t a : acc)
+      h = xxh_merge(h, a);
+  } else {
+    h = seed + prime5;
+  }
+  h += total;
+  const uint8_t* p = pending;
+  const uint8_t* end = pending + pendingBytes;
+  for (; end - p >= 8; p += 8)
+    h = rotl(h ^ xxh_round(0, load64(p)), 27) * prime1 + prime4;
+  if (end - p >= 4) {
+    h = rotl(h ^ (load32(p) * prime1), 23) * prime2 + prime3;
+    p += 4;
+  }
+  for (; p < end; p++)
+    h = rotl(h ^ (*p * prime5), 11) * prime1;
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
@@ -0,0 +1,139 @@
+#include "manto/dns_resolver.hpp"
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+uint16_t read16(const uint8_t* p) {
+  return (p[0] << 8) | p[1];
+}
+
+uint32_t read32(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint8_t* write16(uint8_t* p, uint16_t value) {
+  *p++ = value >> 8;
+  *p++ = value & 0xFF;
+  return p;
+}
+
+// Skips a possibly compressed name, returning the offset just past it or 0.
+size_t skip_name(std::span<const uint8_t> msg, size_t pos) {
+  while (pos < msg.size()) {
+    uint8_t len = msg[pos];
+    if (len == 0) return pos + 1;
+    if ((len & 0xC0) == 0xC0) return pos + 2 <= msg.size() ? pos + 2 : 0;
+    if (len & 0xC0) return 0;
+    pos += 1 + len;
+  }
+  return 0;
+}
+
+}
+
+std::vector<network_address> dns_resolver::system_servers() {
+  std::vector<network_address> servers;
+  std::ifstream in("/etc/resolv.conf");
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream words(line);
+    std::string keyword, address;
+    if (words >> keyword >> address && keyword == "nameserver") {
+      network_address a(address);
+      if (!a.valid()) continue;
+      if (a.sockaddr()->sa_family == AF_INET6)
+        a = network_address("[" + address + "]:53");
+      else
+        a = network_address(address + ":53");
+      if (a.valid()) servers.push_back(a);
+    }
+  }
+  if (servers.empty()) 
+    servers.push_back(network_address("127.0.0.1:53"));
+  return servers;
+}
+
+size_t dns_resolver::build_query(uint8_t* buf, size_t size, uint16_t id, std::string_view name, uint16_t qtype) {
+  if (name.empty() || name.size() > 253 || size < max_query) return 0;
+  uint8_t* p = buf;
+  p = write16(p, id);
+  p = write16(p, 0x0100);   // recursion desired
+  p = write16(p, 1);        // one question
+  p = write16(p, 0);
+  p = write16(p, 0);
+  p = write16(p, 1);        // one additional record, OPT
+  while (!name.empty()) {
+    size_t dot = name.find('.');
+    std::string_view label = name.substr(0, dot);
+    if (label.empty() || label.size() > 63) return 0;
+    *p++ = label.size();
+    memcpy(p, label.data(), label.size());
+    p += label.size();
+    name = dot == std::string_view::npos ? std::string_view() : name.substr(dot + 1);
+  }
+  *p++ = 0;
+  p = write16(p, qtype);
+  p = write16(p, 1);        // class IN
+  // EDNS0: root name, type OPT, 1232 byte UDP payload, no extended flags or options
+  *p++ = 0;
+  p = write16(p, 41);
+  p = write16(p, 1232);
+  p = write16(p, 0);
+  p = write16(p, 0);
+  p = write16(p, 0);
+  return p - buf;
+}
+
+bool dns_resolver::parse_response(std::span<const uint8_t> msg, uint16_t id, uint16_t qtype, uint16_t port, std::vector<network_address>& out, uint32_t& ttl, int& rcode) {
+  if (msg.size() < 12 || read16(msg.data()) != id) return false;
+  uint16_t flags = read16(msg.data() + 2);
+  if (!(flags & 0x8000)) return false;
+  uint16_t qdcount = read16(msg.data() + 4);
+  uint16_t ancount = read16(msg.data() + 6);
+  size_t pos = 12;
+  for (size_t n = 0; n < qdcount; n++) {
+    pos = skip_name(msg, pos);
+    if (pos == 0 || pos + 4 > msg.size()) return false;
+    if (read16(msg.data() + pos) != qtype) return false;
+    pos += 4;
+  }
+  // TC: the answer did not fit, and whatever records made it are partial.
+  if (flags & 0x0200) {
+    rcode = rcode_truncated;
+    return true;
+  }
+  rcode = flags & 0xF;
+  std::vector<network_address> found;
+  uint32_t minTtl = ttl;
+  for (size_t n = 0; n < ancount; n++) {
+    pos = skip_name(msg, pos);
+    if (pos == 0 || pos + 10 > msg.size()) return false;
+    uint16_t type = read16(msg.data() + pos);
+    uint16_t cls = read16(msg.data() + pos + 2);
+    uint32_t recordTtl = read32(msg.data() + pos + 4);
+    uint16_t rdlength = read16(msg.data() + pos + 8);
+    pos += 10;
+    if (pos + rdlength > msg.size()) return false;
+    if (cls == 1 && type == qtype) {
+      if (type == type_a && rdlength == 4) {
+        sockaddr_in in = {};
+        in.sin_family = AF_INET;
+        in.sin_port = htons(port);
+        memcpy(&in.sin_addr, msg.data() + pos, 4);
+        found.emplace_back((const struct sockaddr*)&in, (socklen_t)sizeof(in));
+      } else if (type == type_aaaa && rdlength == 16) {
+        sockaddr_in6 in = {};
+        in.sin6_family = AF_INET6;
+        in.sin6_port = htons(port);
+        memcpy(&in.sin6_addr, msg.data() + pos, 16);
+        found.emplace_back((const struct sockaddr*)&in, (socklen_t)sizeof(in));
+      }
+      minTtl = std::min(minTtl, recordTtl);
+    }
+    pos += rdlength;
+  }
+  out.insert(out.end(), found.begin(), found.end());
+  ttl = minTtl;
+  return true;
+}
@@ -0,0 +1,124 @@
+#include "manto/file_cache.hpp"
+#include <fcntl.h>
+
+file_cache::file_cache(size_t budget, std::chrono::steady_clock::duration revalidateAfter, size_t mapThreshold)
+: budget(budget)
+, mapThreshold(mapThreshold)
+, revalidateAfter(revalidateAfter)
+{
+}
+
+future<result<std::shared_ptr<const cached_file>>> file_cache::get(std::string path) {
+  if (std::shared_ptr<const cached_file> hit = find(path)) co_return hit;
+  auto it = loading.find(path);
+  if (it != loading.end()) {
+    std::shared_ptr<pending_load> pending = it->second;
+    co_await load_waiter(*pending);
+    co_return *pending->outcome;
+  }
+  std::shared_ptr<pending_load> pending = std::make_shared<pending_load>();
+  loading.emplace(path, pending);
+  result<std::shared_ptr<const cached_file>> outcome = co_await load(path);
+  loading.erase(path);
+  if (outcome) insert(path, *outcome);
+  pending->outcome = outcome;
+  pending->waiters.wake_all();
+  co_return outcome;
+}
+
+std::shared_ptr<const cached_file> file_cache::find(const std::string& path) {
+  auto it = entries.find(path);
+  if (it == entries.end()) return nullptr;
+  entry& e = it->second;
+  lru.splice(lru.begin(), lru, e.lru);
+  if (!e.revalidating && std::chrono::steady_clock::now() - e.checked >= revalidateAfter) {
+    e.revalidating = true;
+    revalidate(path, alive);
+  }
+  return e.contents;
+}
+
+void file_cache::erase(const std::string& path) {
+  auto it = entries.find(path);
+  if (it != entries.end()) evict(it);
+}
+
+void file_cache::clear() {
+  entries.clear();
+  lru.clear();
+  used = 0;
+}
+
+future<result<std::shared_ptr<const cached_file>>> file_cache::load(const std::string& path) {
+  result<file> f = co_await file::create(path);
+  if (!f) co_return errno_error{f.error()};
+  // Stat the descriptor rather than the path, so the identity we record is
+  // that of the contents we read even if the path is replaced meanwhile.
+  struct statx st;
+  int rv = co_await async_statx(f->fd, "", AT_EMPTY_PATH, STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &st);
+  if (rv < 0) co_return errno_error{-rv};
+  if (!S_ISREG(st.stx_mode)) co_return errno_error{S_ISDIR(st.stx_mode) ? EISDIR : EINVAL};
+  std::shared_ptr<cached_file> contents = std::make_shared<cached_file>();
+  contents->inode = st.stx_ino;
+  contents->mtime = st.stx_mtime;
+  if (st.stx_size > mapThreshold) {
+    file::mapping m = f->map(0, st.stx_size);
+    if (!m.p) co_return errno_error{errno};
+    contents->size = st.stx_size;
+    contents->mapped.emplace(std::move(m));
+    co_return std::shared_ptr<const cached_file>(std::move(contents));
+  }
+  contents->bytes.resize(st.stx_size);
+  size_t have = 0;
+  while (have < contents->bytes.size()) {
+    result<size_t> n = co_await f->read(contents->bytes.data() + have, contents->bytes.size() - have, have);
+    if (!n) co_return errno_error{n.error()};
+    if (*n == 0) break;
+    have += *n;
+  }
+  contents->bytes.resize(have);
+  contents->size = have;
+  co_return std::shared_ptr<const cached_file>(std::move(contents));
+}
+
+future<Void> file_cache::revalidate(std::string path, std::weak_ptr<int> alive) {
+  struct statx st;
+  int rv = co_await async_statx(AT_FDCWD, path.c_str(), 0, STATX_SIZE | STATX_MTIME | STATX_INO, &st);
+  if (alive.expired()) co_return Void{};
+  auto it = entries.find(path);
+  if (it == entries.end()) co_return Void{};
+  entry& e = it->second;
+  const cached_file& f = *e.contents;
+  if (rv < 0 || st.stx_size != f.size || st.stx_ino != f.inode || st.stx_mtime.tv_sec != f.mtime.tv_sec || st.stx_mtime.tv_nsec != f.mtime.tv_nsec) {
+    evict(it);
+  } else {
+    e.revalidating = false;
+    e.checked = std::chrono::steady_clock::now();
+  }
+  co_return Void{};
+}
+
+void file_cache::insert(const std::string& path, std::shared_ptr<const cached_file> contents) {
+  // Too big to keep; the caller still gets it.
+  if (contents->size > budget) return;
+  auto [it, inserted] = entries.try_emplace(path);
+  entry& e = it->second;
+  if (inserted) {
+    lru.push_front(&it->first);
+    e.lru = lru.begin();
+  } else {
+    used -= e.contents->size;
+    lru.splice(lru.begin(), lru, e.lru);
+  }
+  used += contents->size;
+  e.contents = std::move(contents);
+  e.checked = std::chrono::steady_clock::now();
+  while (used > budget)
+    evict(entries.find(*lru.back()));
+}
+
+void file_cache::evict(std::unordered_map<std::string, entry>::iterator it) {
+  used -= it->second.contents->size;
+  lru.erase(it->second.lru);
+  entries.erase(it);
+}
@@ -1,134 +1,317 @@
 #include "manto/network_address.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-void network_address::parse_ipv4(sockaddr_in* in, const char* str) {
+namespace {
+
+constexpr char hextab[] = "0123456789abcdef";
+
+int hexvalue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// One to three decimal digits without leading zeroes, at most 255.
+bool octet_value(const char* p, size_t len, uint32_t& value) {
+  if (len == 0 || len > 3 || (len > 1 && p[0] == '0')) return false;
+  value = 0;
+  for (size_t n = 0; n < len; n++) {
+    value = value * 10 + (p[n] - '0');
+  }
+  return value <= 255;
+}
+
+}
+
+#if defined(__SSE2__)
+// Classifies up to 16 characters at once: the address is the leading run of
+// digits and dots, and the dot positions give the octet boundaries directly.
+const char* network_address_detail::parse_dotted_quad_sse2(const char* first, const char* last, uint32_t& ipaddr) {
+  alignas(16) char buf[16] = {};
+  memcpy(buf, first, std::min<size_t>(16, last - first));
+  __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+  __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+  uint32_t digitMask = _mm_movemask_epi8(digits);
+  uint32_t dotMask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+  uint32_t len = __builtin_ctz(~(digitMask | dotMask) | 0x10000);
+  if (len > 15) return nullptr;
+  uint32_t dots = dotMask & ((1u << len) - 1);
+  if (__builtin_popcount(dots) != 3) return nullptr;
+  uint32_t d0 = __builtin_ctz(dots); dots &= dots - 1;
+  uint32_t d1 = __builtin_ctz(dots); dots &= dots - 1;
+  uint32_t d2 = __builtin_ctz(dots);
+  uint32_t a, b, c, d;
+  if (!octet_value(buf, d0, a) ||
+      !octet_value(buf + d0 + 1, d1 - d0 - 1, b) ||
+      !octet_value(buf + d1 + 1, d2 - d1 - 1, c) ||
+      !octet_value(buf + d2 + 1, len - d2 - 1, d))
+    return nullptr;
+  ipaddr = (a << 24) | (b << 16) | (c << 8) | d;
+  return first + len;
+}
+#endif
+
+const char* network_address_detail::parse_dotted_quad_scalar(const char* first, const char* last, uint32_t& ipaddr) {
+  const char* p = first;
+  ipaddr = 0;
+  for (int index = 0; index < 4; index++) {
+    if (index) {
+      if (p == last || *p != '.') return nullptr;
+      ++p;
+    }
+    const char* start = p;
+    while (p != last && p - start < 4 && *p >= '0' && *p <= '9') ++p;
+    uint32_t value;
+    if (!octet_value(start, p - start, value)) return nullptr;
+    ipaddr = (ipaddr << 8) | value;
+  }
+  // A fifth part makes it something other than an address, as in the SSE2
+  // version, rather than an address followed by ".5".
+  if (p != last && *p == '.') return nullptr;
+  return p;
+}
+
+namespace {
+
+const char* parse_dotted_quad(const char* first, const char* last, uint32_t& ipaddr) {
+#if defined(__SSE2__)
+  return network_address_detail::parse_dotted_quad_sse2(first, last, ipaddr);
+#else
+  return network_address_detail::parse_dotted_quad_scalar(first, last, ipaddr);
+#endif
+}
+
+// Optional ":port" suffix; returns nullptr if there is one but it is malformed.
+const char* parse_port(const char* p, const char* last, uint16_t& port, std::errc& ec) {
+  port = 0;
+  if (p == last || *p != ':') return p;
+  ++p;
   uint32_t value = 0;
-  uint32_t ipaddr = 0;
-  int index = 0;
-  while (*str) {
-    if (*str == '.' || *str == ':') {
-      ipaddr |= (value << ((3-index) * 8));
-      value = 0;
-      index++;
+  const char* start = p;
+  while (p != last && p - start < 6 && *p >= '0' && *p <= '9') {
+    value = value * 10 + (*p - '0');
+    ++p;
+  }
+  if (p == start) {
+    ec = std::errc::invalid_argument;
+    return nullptr;
+  }
+  if (value > 65535) {
+    ec = std::errc::result_out_of_range;
+    return nullptr;
+  }
+  port = value;
+  return p;
+}
+
+// RFC 4291 text form, including "::" and a trailing dotted quad.
+const char* parse_ipv6(const char* first, const char* last, uint8_t (&addr)[16]) {
+  uint16_t groups[8];
+  int count = 0, gap = -1;
+  const char* p = first;
+  if (last - p >= 2 && p[0] == ':' && p[1] == ':') {
+    gap = 0;
+    p += 2;
+  }
+  while (p != last && count < 8) {
+    const char* start = p;
+    uint32_t value = 0;
+    while (p != last && p - start < 5 && hexvalue(*p) >= 0) {
+      value = (value << 4) | hexvalue(*p);
+      ++p;
+    }
+    if (p == start) break;
+    if (p != last && *p == '.') {
+      uint32_t ipaddr;
+      const char* end = count <= 6 ? parse_dotted_quad(start, last, ipaddr) : nullptr;
+      if (!end) return nullptr;
+      groups[count++] = ipaddr >> 16;
+      groups[count++] = ipaddr & 0xFFFF;
+      p = end;
+      break;
+    }
+    if (p - start > 4) return nullptr;
+    groups[count++] = value;
+    if (p == last || *p != ':' || count == 8) break;
+    if (last - p >= 2 && p[1] == ':') {
+      if (gap >= 0) return nullptr;
+      gap = count;
+      p += 2;
     } else {
-      value = value * 10 + (*str) - '0';
+      ++p;
+      if (p == last || hexvalue(*p) < 0) return nullptr;
     }
-    str++;
   }
-  if (index == 4)
-    in->sin_port = htons(value);
-  else {
-    ipaddr |= (value << ((3-index) * 8));
-    in->sin_port = 0;
+  if (gap < 0 ? count != 8 : count > 7) return nullptr;
+  int tail = gap < 0 ? 0 : count - gap;
+  int head = count - tail;
+  memset(addr, 0, 16);
+  for (int n = 0; n < head; n++) {
+    addr[n*2] = groups[n] >> 8;
+    addr[n*2+1] = groups[n] & 0xFF;
   }
-  in->sin_family = AF_INET;
-  in->sin_addr.s_addr = htonl(ipaddr);
+  for (int n = 0; n < tail; n++) {
+    addr[16 - tail*2 + n*2] = groups[head + n] >> 8;
+    addr[16 - tail*2 + n*2 + 1] = groups[head + n] & 0xFF;
+  }
+  return p;
 }
 
-void network_address::parse_ipv6_noport(sockaddr_in6* in, const char*& str) {
-  uint16_t front[8];
-  uint16_t back[8];
-  int f_i = 0, b_i = 0;
-  uint16_t accum = 0;
-  bool atBack = false;
-  while (*str != ']' && *str != '\0') {
-    switch(*str) {
-      case ':': 
-        if (atBack) {
-          back[b_i] = accum;
-          b_i++;
-        } else {
-          front[f_i] = accum; 
-          f_i++;
-        }
-        if (str[1] == ':') atBack = true;
-        accum = 0;
-        break;
-      default:
-        accum = (accum << 4) + *str - '0';
-        if (*str >= 'A') accum -= 7;
-        if (*str >= 'a') accum -= 32;
-        break;
-    }
-    ++str;
+char* format_decimal(char* p, uint32_t value) {
+  char digits[10];
+  size_t n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (n) *p++ = digits[--n];
+  return p;
+}
+
+char* format_dotted_quad(char* p, const uint8_t* bytes) {
+  for (size_t n = 0; n < 4; n++) {
+    if (n) *p++ = '.';
+    p = format_decimal(p, bytes[n]);
   }
-  if (atBack) {
-    back[b_i] = accum;
-    b_i++;
-  } else {
-    front[f_i] = accum; 
-    f_i++;
+  return p;
+}
+
+// RFC 5952: lowercase, no leading zeroes, longest run of two or more zero
+// groups collapsed to "::", IPv4-mapped addresses in dotted form.
+char* format_ipv6(char* p, const uint8_t* bytes) {
+  static constexpr uint8_t mapped[12] = { 0,0,0,0,0,0,0,0,0,0,0xFF,0xFF };
+  if (memcmp(bytes, mapped, 12) == 0) {
+    memcpy(p, "::ffff:", 7);
+    return format_dotted_quad(p + 7, bytes + 12);
   }
-  int index = 0;
-  for (; index < f_i; ++index) {
-    in->sin6_addr.s6_addr[index*2] = (front[index] & 0xFF00) >> 8;
-    in->sin6_addr.s6_addr[index*2+1] = (front[index] & 0xFF);
+  uint16_t groups[8];
+  for (size_t n = 0; n < 8; n++) {
+    groups[n] = (bytes[n*2] << 8) | bytes[n*2+1];
   }
-  for (; index < (8 - b_i); ++index) {
-    in->sin6_addr.s6_addr[index*2] = 0;
-    in->sin6_addr.s6_addr[index*2+1] = 0;
+  int bestStart = -1, bestLen = 1;
+  for (int n = 0; n < 8;) {
+    if (groups[n] != 0) {
+      n++;
+      continue;
+    }
+    int start = n;
+    while (n < 8 && groups[n] == 0) n++;
+    if (n - start > bestLen) {
+      bestStart = start;
+      bestLen = n - start;
+    }
   }
-  for (; index < 8; ++index) {
-    in->sin6_addr.s6_addr[index*2] = (back[index + b_i - 8] & 0xFF00) >> 8;
-    in->sin6_addr.s6_addr[index*2+1] = (back[index + b_i - 8] & 0xFF);
+  for (int n = 0; n < 8; n++) {
+    if (n == bestStart) {
+      *p++ = ':';
+      if (n == 0) *p++ = ':';
+      n += bestLen - 1;
+      continue;
+    }
+    int shift = 12;
+    while (shift > 0 && ((groups[n] >> shift) & 0xF) == 0) shift -= 4;
+    for (; shift >= 0; shift -= 4) {
+      *p++ = hextab[(groups[n] >> shift) & 0xF];
+    }
+    if (n != 7) *p++ = ':';
   }
+  return p;
+}
+
 }
 
-void network_address::parse_ipv6(sockaddr_in6* in, const char* str) {
-  if (*str == '[') {
-    str++;
-    parse_ipv6_noport(in, str);
-    str++;
-    str++;
-    uint16_t port = 0;
-    while (*str) {
-      port = (port * 10) + *str - '0';
-      ++str;
+std::from_chars_result network_address::from_chars(const char* first, const char* last, network_address& out) noexcept {
+  std::errc ec = std::errc::invalid_argument;
+  if (first == last) return {first, ec};
+  if (*first != '[') {
+    uint32_t ipaddr;
+    if (const char* p = parse_dotted_quad(first, last, ipaddr)) {
+      uint16_t port;
+      p = parse_port(p, last, port, ec);
+      if (!p) return {first, ec};
+      out.resize(sizeof(sockaddr_in));
+      sockaddr_in* in = reinterpret_cast<sockaddr_in*>(out.buffer());
+      memset(in, 0, sizeof(*in));
+      in->sin_family = AF_INET;
+      in->sin_port = htons(port);
+      in->sin_addr.s_addr = htonl(ipaddr);
+      return {p, std::errc()};
     }
-    in->sin6_port = htons(port);
-  } else {
-    parse_ipv6_noport(in, str);
-    in->sin6_port = 0;
   }
+  bool bracketed = (*first == '[');
+  uint8_t addr[16];
+  const char* p = parse_ipv6(first + bracketed, last, addr);
+  if (!p) return {first, ec};
+  uint16_t port = 0;
+  if (bracketed) {
+    if (p == last || *p != ']') return {first, ec};
+    p = parse_port(p + 1, last, port, ec);
+    if (!p) return {first, ec};
+  }
+  out.resize(sizeof(sockaddr_in6));
+  sockaddr_in6* in = reinterpret_cast<sockaddr_in6*>(out.buffer());
+  memset(in, 0, sizeof(*in));
   in->sin6_family = AF_INET6;
+  in->sin6_port = htons(port);
+  memcpy(in->sin6_addr.s6_addr, addr, 16);
+  return {p, std::errc()};
 }
 
-void network_address::parse_ipv6_wrapped_ipv4(sockaddr_in6* in, const char* str) {
-  if (*str == '[') str++;
-  str += 7;
-  uint32_t value = 0;
-  uint32_t ipaddr = 0;
-  int index = 0;
-  while (*str && *str != ']') {
-    if (*str == '.') {
-      ipaddr |= (value << ((3-index) * 8));
-      value = 0;
-      index++;
-    } else {
-      value = value * 10 + (*str) - '0';
+network_address network_address::unix_path(std::string_view path) noexcept {
+  network_address out;
+  sockaddr_un un;
+  if (path.empty() || path.size() >= sizeof(un.sun_path)) return out;
+  memset(&un, 0, sizeof(un));
+  un.sun_family = AF_UNIX;
+  memcpy(un.sun_path, path.data(), path.size());
+  socklen_t length = offsetof(sockaddr_un, sun_path) + path.size();
+  // Abstract names are not NUL terminated; their length is the address length.
+  if (path[0] == '@')
+    un.sun_path[0] = '\0';
+  else
+    length++;
+  out.resize(length);
+  memcpy(out.buffer(), &un, length);
+  return out;
+}
+
+std::to_chars_result network_address::to_chars(char* first, char* last) const noexcept {
+  if (namelen >= offsetof(sockaddr_un, sun_path) && sockaddr()->sa_family == AF_UNIX) {
+    const char* path = buffer() + offsetof(sockaddr_un, sun_path);
+    size_t length = namelen - offsetof(sockaddr_un, sun_path);
+    if (length && path[0] != '\0') 
+      length = strnlen(path, length);
+    if ((size_t)(last - first) < length) return {last, std::errc::value_too_large};
+    memcpy(first, path, length);
+    if (length && path[0] == '\0') *first = '@';
+    return {first + length, std::errc()};
+  }
+  char text[max_chars];
+  char* p = text;
+  if (namelen >= sizeof(sockaddr_in) && sockaddr()->sa_family == AF_INET) {
+    const sockaddr_in* a = reinterpret_cast<const sockaddr_in*>(buffer());
+    p = format_dotted_quad(p, reinterpret_cast<const uint8_t*>(&a->sin_addr.s_addr));
+    if (a->sin_port) {
+      *p++ = ':';
+      p = format_decimal(p, ntohs(a->sin_port));
     }
-    str++;
-  }
-  ipaddr |= (value << ((3-index) * 8));
-  if (*str == ']') {
-    str++;
-    str++;
-    uint16_t port = 0;
-    while (*str) {
-      port = (port * 10) + *str - '0';
-      ++str;
+  } else if (namelen >= sizeof(sockaddr_in6) && sockaddr()->sa_family == AF_INET6) {
+    const sockaddr_in6* a = reinterpret_cast<const sockaddr_in6*>(buffer());
+    if (a->sin6_port) *p++ = '[';
+    p = format_ipv6(p, a->sin6_addr.s6_addr);
+    if (a->sin6_port) {
+      *p++ = ']';
+      *p++ = ':';
+      p = format_decimal(p, ntohs(a->sin6_port));
     }
-    in->sin6_port = htons(port);
   } else {
-    in->sin6_port = 0;
+    return {last, std::errc::invalid_argument};
   }
-  for (size_t n = 0; n < 16; n++) {
-    if (n < 12) {
-      in->sin6_addr.s6_addr[n] = (n < 10 ? 0 : 255);
-    } else {
-      in->sin6_addr.s6_addr[n] = (ipaddr >> ((15-n) * 8)) & 0xFF;
-    }
-  }
-  in->sin6_family = AF_INET6;
+  size_t length = p - text;
+  if ((size_t)(last - first) < length) return {last, std::errc::value_too_large};
+  memcpy(first, text, length);
+  return {first + length, std::errc()};
 }
-
-
@@ -0,0 +1,94 @@
+#include "manto/offload.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+  // Tasks a worker moves from the shared queue into its deque at once.
+  constexpr size_t batch = 16;
+}
+
+offload_pool::offload_pool(unsigned threads) {
+  for (unsigned n = 0; n < threads; n++)
+    queues.push_back(std::make_unique<work_stealing_deque<offload_task>>());
+  for (unsigned n = 0; n < threads; n++)
+    workers.emplace_back([this, n] { work(n); });
+}
+
+offload_pool::~offload_pool() {
+  {
+    std::lock_guard<std::mutex> l(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& t : workers)
+    t.join();
+}
+
+void offload_pool::submit(offload_task* task) {
+  {
+    std::lock_guard<std::mutex> l(lock);
+    injected.push_back(task);
+  }
+  wake.notify_one();
+}
+
+void offload_pool::work(unsigned index) {
+  work_stealing_deque<offload_task>& local = *queues[index];
+  for (;;) {
+    offload_task* task = local.pop();
+    if (!task) task = take(local);
+    if (!task) task = steal(index);
+    if (task) {
+      task->run();
+      finish(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> l(lock);
+    if (!injected.empty()) continue;
+    if (stopping) return;
+    wake.wait(l);
+  }
+}
+
+// Takes one task to run now and queues up to a batch more locally, where idle
+// workers can steal them.
+offload_task* offload_pool::take(work_stealing_deque<offload_task>& local) {
+  std::lock_guard<std::mutex> l(lock);
+  if (injected.empty()) return nullptr;
+  offload_task* task = injected.front();
+  injected.pop_front();
+  size_t moved = 0;
+  while (moved < batch && !injected.empty() && local.push(injected.front())) {
+    injected.pop_front();
+    moved++;
+  }
+  if (moved) wake.notify_one();
+  return task;
+}
+
+offload_task* offload_pool::steal(unsigned thief) {
+  for (size_t n = 1; n < queues.size(); n++) {
+    if (offload_task* task = queues[(thief + n) % queues.size()]->steal())
+      return task;
+  }
+  return nullptr;
+}
+
+// Posts the completion to the task's ring through this worker's own ring. The
+// coroutine may resume and free the task as soon as that is submitted.
+void offload_pool::finish(offload_task* task) {
+  int ringFd = task->ringFd;
+  uintptr_t completion = (uintptr_t)&task->completion;
+  task->ran.store(true, std::memory_order_release);
+  syscall_rv<int> posted = async_msg_ring(ringFd, 0, completion);
+  get_ring().run();
+  if (posted.rv < 0) {
+    fprintf(stderr, "FATAL offload: cannot resume on ring %d: %s\n", ringFd, strerror(-posted.rv));
+    abort();
+  }
+}
+
+offload_pool& default_offload_pool() {
+  static offload_pool pool;
+  return pool;
+}
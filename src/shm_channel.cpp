@@ -0,0 +1,117 @@
+#include "manto/shm_channel.hpp"
+#include <bit>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+  constexpr uint32_t channel_magic = 0x6d6e7463; // "mntc"
+
+  size_t header_size() {
+    return (sizeof(shm_channel_header) + 63) & ~size_t(63);
+  }
+
+  void close_all(std::array<int, 3> handles) {
+    for (int fd : handles)
+      if (fd >= 0) close(fd);
+  }
+}
+
+shm_channel::shm_channel(file memory, file::mapping region, int wakeFd, int spaceFd)
+: memory(std::move(memory))
+, region(std::move(region))
+, header(reinterpret_cast<shm_channel_header*>(this->region.p))
+, slots(this->region.p + header_size())
+, wakeFd(wakeFd)
+, spaceFd(spaceFd)
+{
+}
+
+shm_channel::shm_channel(shm_channel&& rhs)
+: memory(std::move(rhs.memory))
+, region(std::move(rhs.region))
+, header(rhs.header)
+, slots(rhs.slots)
+, wakeFd(std::exchange(rhs.wakeFd, -1))
+, spaceFd(std::exchange(rhs.spaceFd, -1))
+, holding(rhs.holding)
+{
+}
+
+shm_channel& shm_channel::operator=(shm_channel&& rhs) {
+  if (this == &rhs) return *this;
+  close_all({ -1, wakeFd, spaceFd });
+  memory = std::move(rhs.memory);
+  region = std::move(rhs.region);
+  header = rhs.header;
+  slots = rhs.slots;
+  wakeFd = std::exchange(rhs.wakeFd, -1);
+  spaceFd = std::exchange(rhs.spaceFd, -1);
+  holding = rhs.holding;
+  return *this;
+}
+
+shm_channel::~shm_channel() {
+  close_all({ -1, wakeFd, spaceFd });
+}
+
+result<shm_channel> shm_channel::create(uint32_t capacity, uint32_t slotSize, bool multipleProducers) {
+  if (capacity == 0 || slotSize == 0) return errno_error{EINVAL};
+  capacity = std::bit_ceil(capacity);
+  // Slots are cache-line aligned so neighbouring messages never share a line.
+  uint32_t stride = (slot_data + slotSize + 63) & ~63u;
+  size_t size = header_size() + size_t(capacity) * stride;
+  std::array<int, 3> handles = {
+    memfd_create("manto-channel", MFD_CLOEXEC),
+    eventfd(0, EFD_CLOEXEC),
+    eventfd(0, EFD_CLOEXEC),
+  };
+  if (handles[0] < 0 || handles[1] < 0 || handles[2] < 0 || ftruncate(handles[0], size) < 0) {
+    int error = errno;
+    close_all(handles);
+    return errno_error{error};
+  }
+  file memory(handles[0], file::Mode::Overwrite);
+  file::mapping region = memory.map(0, size);
+  if (!region.p) {
+    int error = errno;
+    close_all({ -1, handles[1], handles[2] });
+    return errno_error{error};
+  }
+  shm_channel_header* header = new (region.p) shm_channel_header{};
+  header->magic = channel_magic;
+  header->capacity = capacity;
+  header->slotSize = slotSize;
+  header->stride = stride;
+  header->multipleProducers = multipleProducers;
+  for (uint64_t n = 0; n < capacity; n++)
+    new (region.p + header_size() + n * stride) std::atomic<uint64_t>(n);
+  return shm_channel(std::move(memory), std::move(region), handles[1], handles[2]);
+}
+
+result<shm_channel> shm_channel::open(std::array<int, 3> handles) {
+  struct stat st;
+  if (fstat(handles[0], &st) < 0) {
+    int error = errno;
+    close_all(handles);
+    return errno_error{error};
+  }
+  if (size_t(st.st_size) < header_size()) {
+    close_all(handles);
+    return errno_error{EINVAL};
+  }
+  file memory(handles[0], file::Mode::Overwrite);
+  file::mapping region = memory.map(0, st.st_size);
+  if (!region.p) {
+    int error = errno;
+    close_all({ -1, handles[1], handles[2] });
+    return errno_error{error};
+  }
+  const shm_channel_header* header = reinterpret_cast<const shm_channel_header*>(region.p);
+  if (header->magic != channel_magic || !std::has_single_bit(header->capacity) || header->stride < slot_data + header->slotSize
+      || size_t(st.st_size) < header_size() + size_t(header->capacity) * header->stride) {
+    close_all({ -1, handles[1], handles[2] });
+    return errno_error{EINVAL};
+  }
+  return shm_channel(std::move(memory), std::move(region), handles[1], handles[2]);
+}
@@ -20,43 +20,43 @@ namespace {
   }
 }
 
-future<ssize_t> stdio::read(uint8_t* p, size_t count) {
+future<result<size_t>> stdio::read(uint8_t* p, size_t count) {
   return in().read(p, count, 0);
 }
 
-future<ssize_t> stdio::read(char* p, size_t count) {
+future<result<size_t>> stdio::read(char* p, size_t count) {
   return in().read(reinterpret_cast<uint8_t*>(p), count, 0);
 }
 
-future<ssize_t> stdio::write(std::span<const uint8_t> msg) {
+future<result<size_t>> stdio::write(std::span<const uint8_t> msg) {
   return out().write(msg, 0);
 }
 
-future<ssize_t> stdio::write(std::string_view msg) {
+future<result<size_t>> stdio::write(std::string_view msg) {
   return out().write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(msg.data()), msg.size()), 0);
 }
 
-future<ssize_t> stdio::write(std::u8string_view msg) {
+future<result<size_t>> stdio::write(std::u8string_view msg) {
   return out().write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(msg.data()), msg.size()), 0);
 }
 
-future<ssize_t> stdio::write(const char* msg) {
+future<result<size_t>> stdio::write(const char* msg) {
   return out().write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(msg), strlen(msg)), 0);
 }
 
-future<ssize_t> stdio::error(std::span<const uint8_t> msg) {
+future<result<size_t>> stdio::error(std::span<const uint8_t> msg) {
   return err().write(msg, 0);
 }
 
-future<ssize_t> stdio::error(std::u8string_view msg) {
+future<result<size_t>> stdio::error(std::u8string_view msg) {
   return err().write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(msg.data()), msg.size()), 0);
 }
 
-future<ssize_t> stdio::error(std::string_view msg) {
+future<result<size_t>> stdio::error(std::string_view msg) {
   return err().write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(msg.data()), msg.size()), 0);
 }
 
-future<ssize_t> stdio::error(const char* msg) {
+future<result<size_t>> stdio::error(const char* msg) {
   return err().write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(msg), strlen(msg)), 0);
 }
 
@@ -66,7 +66,7 @@ file::file(int fd, Mode mode)
 {
 }
 
-future<file> file::create(const std::string& filename, Mode mode)
+future<result<file>> file::create(const std::string& filename, Mode mode)
 {
   int m = O_LARGEFILE | O_CLOEXEC;
   switch(mode) {
@@ -76,18 +76,24 @@ future<file> file::create(const std::string& filename, Mode mode)
     case Mode::Overwrite: m |= O_RDWR | O_CREAT; break;
     case Mode::Readonly: m |= O_RDONLY; break;
   }
-  int fd = co_await async_openat(AT_FDCWD, filename.c_str(), 0, m);
+  int fd = co_await async_openat(AT_FDCWD, filename.c_str(), m, 0666);
+  if (fd < 0) co_return errno_error{-fd};
   co_return file(fd, mode);
 }
 
-file::file(file&& rhs) {
-  fd = rhs.fd;
-  rhs.fd = -1;
+file::file(file&& rhs) 
+: mode(rhs.mode)
+, fd(std::exchange(rhs.fd, -1))
+, currentOffset(rhs.currentOffset)
+{
 }
 
 file& file::operator=(file&& rhs) {
-  fd = rhs.fd;
-  rhs.fd = -1;
+  if (this == &rhs) return *this;
+  if (fd > 2) close(fd);
+  mode = rhs.mode;
+  fd = std::exchange(rhs.fd, -1);
+  currentOffset = rhs.currentOffset;
   return *this;
 }
 
@@ -96,16 +102,46 @@ file::~file() {
   if (fd > 2) close(fd);
 }
 
-future<ssize_t> file::read(uint8_t* p, size_t count, ssize_t offset) {
-  co_return co_await async_read(fd, p, count, offset == -1 ? currentOffset : offset);
+future<result<size_t>> file::read(uint8_t* p, size_t count, ssize_t offset) {
+  co_return syscall_result<size_t>(co_await async_read(fd, p, count, offset == -1 ? currentOffset : offset));
+}
+
+future<result<size_t>> file::write(std::span<const uint8_t> msg, ssize_t offset) {
+  co_return syscall_result<size_t>(co_await async_write(fd, (void*)msg.data(), msg.size(), offset == -1 ? currentOffset : offset));
+}
+
+async_generator<std::span<const uint8_t>> file::stream(std::span<uint8_t> buffer, size_t offset) {
+  for (;;) {
+    ssize_t bytes = co_await async_read(fd, buffer.data(), buffer.size(), offset);
+    if (bytes < 0) co_yield errno_error{int(-bytes)};
+    if (bytes <= 0) co_return;
+    offset += bytes;
+    co_yield std::span<const uint8_t>(buffer.data(), bytes);
+  }
+}
+
+file::mapping::mapping(uint8_t* p, size_t length)
+: p(p)
+, length(length)
+{
 }
 
-future<ssize_t> file::write(std::span<const uint8_t> msg, ssize_t offset) {
-  co_return co_await async_write(fd, (void*)msg.data(), msg.size(), offset == -1 ? currentOffset : offset);
+file::mapping::mapping(mapping&& rhs)
+: p(std::exchange(rhs.p, nullptr))
+, length(std::exchange(rhs.length, 0))
+{
+}
+
+file::mapping& file::mapping::operator=(mapping&& rhs) {
+  if (this == &rhs) return *this;
+  if (p) munmap(p, length);
+  p = std::exchange(rhs.p, nullptr);
+  length = std::exchange(rhs.length, 0);
+  return *this;
 }
 
 file::mapping::~mapping() {
-  munmap(p, length);
+  if (p) munmap(p, length);
 }
 
 std::span<uint8_t> file::mapping::region() {
@@ -116,6 +152,7 @@ std::span<uint8_t> file::mapping::region() {
   static size_t pagesize = sysconf(_SC_PAGE_SIZE);
   size_t length_to_page = ((length + pagesize - 1) / pagesize) * pagesize;
   void* p = mmap(nullptr, length_to_page, PROT_READ | (mode == Mode::Readonly ? 0 : PROT_WRITE), MAP_SHARED, fd, start);
+  if (p == MAP_FAILED) return {nullptr, 0};
   return {(uint8_t*)p, length_to_page};
 }
 
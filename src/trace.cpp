@@ -0,0 +1,90 @@
+#include "manto/trace.hpp"
+
+#ifdef MANTO_TRACE
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+std::atomic<unsigned> trace_sampling = 1;
+
+namespace {
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<trace_buffer>> registry;
+
+// Buffers stay registered after their thread exits so its events can still be dumped.
+std::shared_ptr<trace_buffer> register_thread() {
+  auto buffer = std::make_shared<trace_buffer>();
+  std::lock_guard<std::mutex> lock(registryMutex);
+  buffer->tid = registry.size() + 1;
+  registry.push_back(buffer);
+  return buffer;
+}
+
+const char* names[] = { "coroutine", "coroutine", "await", "await", "op", "op" };
+const char* categories[] = { "coro", "coro", "coro", "coro", "io", "io" };
+const char* phases[] = { "b", "e", "b", "e", "b", "e" };
+
+void write_event(FILE* out, const trace_event& e, uint32_t tid, bool first) {
+  unsigned k = (unsigned)e.kind;
+  fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"id\":\"%p\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03llu",
+          first ? "" : ",", names[k], categories[k], phases[k], e.id, tid,
+          (unsigned long long)(e.ts / 1000), (unsigned long long)(e.ts % 1000));
+  switch (e.kind) {
+  case trace_kind::await_begin:
+    if (e.opcode)
+      fprintf(out, ",\"args\":{\"op\":\"%p\",\"opcode\":%u}", e.target, e.opcode);
+    else
+      fprintf(out, ",\"args\":{\"coroutine\":\"%p\"}", e.target);
+    break;
+  case trace_kind::op_begin:
+    fprintf(out, ",\"args\":{\"opcode\":%u}", e.opcode);
+    break;
+  case trace_kind::op_end:
+    fprintf(out, ",\"args\":{\"res\":%d}", e.value);
+    break;
+  default:
+    break;
+  }
+  fputc('}', out);
+}
+
+}
+
+void trace_set_sampling(unsigned oneIn) {
+  trace_sampling.store(oneIn, std::memory_order_relaxed);
+}
+
+trace_buffer& trace_thread_buffer() {
+  thread_local std::shared_ptr<trace_buffer> buffer = register_thread();
+  return *buffer;
+}
+
+void trace_dump(FILE* out) {
+  std::vector<std::shared_ptr<trace_buffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffers = registry;
+  }
+  fputs("{\"traceEvents\":[", out);
+  bool first = true;
+  std::vector<trace_event> events;
+  for (auto& b : buffers) {
+    uint64_t end = b->head.load(std::memory_order_acquire);
+    uint64_t begin = end > trace_buffer::capacity ? end - trace_buffer::capacity : 0;
+    events.clear();
+    for (uint64_t n = begin; n < end; n++)
+      events.push_back(b->events[n & (trace_buffer::capacity - 1)]);
+    // Anything the owner wrapped over while we were copying is unreliable.
+    uint64_t now = b->head.load(std::memory_order_acquire);
+    size_t skip = now > begin + trace_buffer::capacity ? std::min<uint64_t>(events.size(), now - begin - trace_buffer::capacity) : 0;
+    for (size_t n = skip; n < events.size(); n++) {
+      write_event(out, events[n], b->tid, first);
+      first = false;
+    }
+  }
+  fputs("\n],\"displayTimeUnit\":\"ns\"}\n", out);
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include "manto/ring_stats.hpp"
+#include "manto/tcp_socket.hpp"
+#include "manto/udp_socket.hpp"
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Open-loop load generator. Requests are scheduled at a fixed rate and dealt
+// out round-robin over the connections, and every request carries the time it
+// was meant to be sent. Latency is measured from that time instead of from when
+// it actually went out, so a server that stalls shows up as queueing delay in
+// the tail rather than as fewer, faster samples (coordinated omission).
+//
+//   manto_loadgen --serve 127.0.0.1:9000
+//   manto_loadgen 127.0.0.1:9000 --rate 20000 --connections 16 --duration 10
+//
+// The target has to echo each request back unchanged, like --serve does.
+
+namespace {
+
+struct options {
+  network_address target;
+  bool serve = false;
+  bool udp = false;
+  bool histogram = false;
+  double rate = 1000;
+  unsigned connections = 8;
+  double duration = 10;
+  size_t size = 64;
+};
+
+// Sent at the front of every request and echoed back.
+struct request_header {
+  uint64_t intended;
+  uint64_t sequence;
+};
+
+struct schedule {
+  uint64_t start;
+  double interval;
+  uint64_t count;
+  uint64_t intended(uint64_t n) const {
+    return start + uint64_t(n * interval);
+  }
+  // Requests that go out over connection `index` of `connections`.
+  uint64_t share(unsigned index, unsigned connections) const {
+    return count > index ? (count - index + connections - 1) / connections : 0;
+  }
+};
+
+struct results {
+  log_histogram<7> latency;
+  uint64_t sent = 0, received = 0, lost = 0, maxLag = 0, lastReply = 0;
+};
+
+uint64_t now() {
+  return ring_stats::now();
+}
+
+// steady_clock is CLOCK_MONOTONIC, which is also what absolute ring timeouts use.
+future<Void> sleep_until(uint64_t when) {
+  if (now() < when) {
+    __kernel_timespec ts = { int64_t(when / 1000000000), int64_t(when % 1000000000) };
+    co_await async_timeout(&ts, IORING_TIMEOUT_ABS);
+  }
+  co_return {};
+}
+
+// Fills in the header and notes how far behind schedule the sender is.
+void stamp(std::vector<uint8_t>& msg, const schedule& sched, uint64_t n, results& r) {
+  request_header h = { sched.intended(n), n };
+  memcpy(msg.data(), &h, sizeof(h));
+  r.maxLag = std::max(r.maxLag, now() - std::min(now(), h.intended));
+}
+
+void record(const uint8_t* reply, results& r) {
+  request_header h;
+  memcpy(&h, reply, sizeof(h));
+  r.lastReply = now();
+  r.latency.record(r.lastReply - h.intended);
+  r.received++;
+}
+
+future<Void> tcp_receiver(tcp_socket& s, const options& o, uint64_t expected, results& r) {
+  std::vector<uint8_t> reply(o.size);
+  for (uint64_t n = 0; n < expected; n++) {
+    for (size_t got = 0; got < o.size;) {
+      result<size_t> bytes = co_await s.recvmsg(reply.data() + got, o.size - got);
+      if (!bytes || *bytes == 0) {
+        r.lost += expected - n;
+        co_return {};
+      }
+      got += *bytes;
+    }
+    record(reply.data(), r);
+  }
+  co_return {};
+}
+
+// Sending never waits for replies; those are read concurrently on the same socket.
+future<Void> tcp_connection(const options& o, const schedule& sched, unsigned index, results& r) {
+  result<tcp_socket> sock = co_await tcp_socket::create(o.target);
+  if (!sock) {
+    fprintf(stderr, "connect: %s\n", strerror(sock.error()));
+    r.lost += sched.share(index, o.connections);
+    co_return {};
+  }
+  tcp_socket& s = *sock;
+  future<Void> receiver = tcp_receiver(s, o, sched.share(index, o.connections), r);
+  std::vector<uint8_t> msg(o.size, 0x5A);
+  for (uint64_t n = index; n < sched.count; n += o.connections) {
+    co_await sleep_until(sched.intended(n));
+    stamp(msg, sched, n, r);
+    if (!co_await s.sendmsg(msg)) break;
+    r.sent++;
+  }
+  co_await receiver;
+  co_return {};
+}
+
+// Datagrams can get lost, so the receiver gives up a second after the last send.
+future<Void> udp_receiver(udp_socket& s, const options& o, uint64_t expected, uint64_t deadline, results& r) {
+  std::vector<uint8_t> reply(std::max<size_t>(o.size, 65536));
+  uint64_t n = 0;
+  while (n < expected) {
+    uint64_t t = now();
+    if (t >= deadline) break;
+    __kernel_timespec ts = { int64_t((deadline - t) / 1000000000), int64_t((deadline - t) % 1000000000) };
+    struct iovec iov = { reply.data(), reply.size() };
+    struct msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    ssize_t bytes = co_await async_recvmsg(s.fd, &hdr, 0, &ts);
+    if (bytes == -ECANCELED) break;
+    if (bytes < (ssize_t)sizeof(request_header)) continue;
+    record(reply.data(), r);
+    n++;
+  }
+  r.lost += expected - n;
+  co_return {};
+}
+
+future<Void> udp_connection(const options& o, const schedule& sched, unsigned index, results& r) {
+  udp_socket s(0, o.target.family());
+  uint64_t deadline = sched.intended(sched.count) + 1000000000;
+  future<Void> receiver = udp_receiver(s, o, sched.share(index, o.connections), deadline, r);
+  std::vector<uint8_t> msg(o.size, 0x5A);
+  for (uint64_t n = index; n < sched.count; n += o.connections) {
+    co_await sleep_until(sched.intended(n));
+    stamp(msg, sched, n, r);
+    if (co_await s.sendmsg(o.target, msg)) r.sent++;
+  }
+  co_await receiver;
+  co_return {};
+}
+
+future<Void> tcp_echo(tcp_socket s) {
+  std::vector<uint8_t> buffer(65536);
+  for (;;) {
+    result<size_t> bytes = co_await s.recvmsg(buffer.data(), buffer.size());
+    if (!bytes || *bytes == 0) break;
+    if (!co_await s.sendmsg({buffer.data(), *bytes})) break;
+  }
+  co_return {};
+}
+
+future<Void> udp_echo(udp_socket& s) {
+  for (;;) {
+    auto msg = co_await s.recvmsg(65536);
+    if (msg) (void)co_await s.sendmsg(msg->first, msg->second);
+  }
+}
+
+void serve(const options& o) {
+  std::vector<future<Void>> connections;
+  tcp_listen_socket listener(tcp_listen_socket::listen_fd(o.target, false, SOMAXCONN), [&](tcp_socket s) {
+    std::erase_if(connections, [](future<Void>& f) { return f.await_ready(); });
+    connections.push_back(tcp_echo(std::move(s)));
+  });
+  udp_socket udp(o.target);
+  future<Void> echo = udp_echo(udp);
+  printf("echoing tcp and udp on %s\n", to_string(o.target).c_str());
+  async_run();
+}
+
+void print_results(const options& o, const results& r, double elapsed) {
+  printf("%s %s: %.0f req/s over %u connections, %zu byte requests\n",
+         o.udp ? "udp" : "tcp", to_string(o.target).c_str(), o.rate, o.connections, o.size);
+  printf("sent %llu, received %llu, lost %llu, achieved %.0f req/s, max send lag %.1f us\n",
+         (unsigned long long)r.sent, (unsigned long long)r.received, (unsigned long long)r.lost,
+         r.received / elapsed, r.maxLag / 1e3);
+  printf("latency (us):");
+  for (double p : { 50.0, 90.0, 99.0, 99.9, 99.99 })
+    printf(" p%g %.1f", p, r.latency.percentile(p) / 1e3);
+  printf(" max %.1f mean %.1f\n", r.latency.max / 1e3, r.latency.mean() / 1e3);
+  if (!o.histogram || r.latency.total == 0) return;
+  // Percentile spectrum in the layout of HdrHistogram's output.
+  printf("%12s %14s %10s %14s\n", "Value(us)", "Percentile", "TotalCount", "1/(1-Percentile)");
+  uint64_t seen = 0;
+  for (unsigned n = 0; n < r.latency.counts.size(); n++) {
+    if (!r.latency.counts[n]) continue;
+    seen += r.latency.counts[n];
+    double fraction = double(seen) / r.latency.total;
+    double value = std::min(r.latency.max, r.latency.lowest(n + 1) - 1) / 1e3;
+    if (fraction < 1)
+      printf("%12.1f %14.12f %10llu %14.2f\n", value, fraction, (unsigned long long)seen, 1 / (1 - fraction));
+    else
+      printf("%12.1f %14.12f %10llu\n", value, fraction, (unsigned long long)seen);
+  }
+}
+
+void usage() {
+  fprintf(stderr,
+    "usage: manto_loadgen <address:port> [--rate req/s] [--connections n] [--duration s]\n"
+    "                     [--size bytes] [--udp] [--histogram]\n"
+    "       manto_loadgen --serve <address:port>\n");
+  exit(1);
+}
+
+}
+
+int main(int argc, char** argv) {
+  options o;
+  for (int n = 1; n < argc; n++) {
+    std::string arg = argv[n];
+    bool hasValue = n + 1 < argc;
+    if (arg == "--serve") o.serve = true;
+    else if (arg == "--udp") o.udp = true;
+    else if (arg == "--histogram") o.histogram = true;
+    else if (arg == "--rate" && hasValue) o.rate = atof(argv[++n]);
+    else if (arg == "--connections" && hasValue) o.connections = atoi(argv[++n]);
+    else if (arg == "--duration" && hasValue) o.duration = atof(argv[++n]);
+    else if (arg == "--size" && hasValue) o.size = atoi(argv[++n]);
+    else if (arg[0] != '-') o.target = network_address(arg);
+    else usage();
+  }
+  if (!o.target.valid() || o.rate <= 0 || o.connections == 0 || o.duration <= 0) usage();
+  if (o.serve) {
+    serve(o);
+    return 0;
+  }
+  o.size = std::max(o.size, sizeof(request_header));
+  // Leave the connections a moment to come up before the first request is due.
+  schedule sched = { now() + 100000000, 1e9 / o.rate, uint64_t(std::llround(o.rate * o.duration)) };
+  results r;
+  std::vector<future<Void>> connections;
+  for (unsigned n = 0; n < o.connections; n++)
+    connections.push_back(o.udp ? udp_connection(o, sched, n, r) : tcp_connection(o, sched, n, r));
+  async_run();
+  print_results(o, r, r.lastReply > sched.start ? (r.lastReply - sched.start) / 1e9 : o.duration);
+}